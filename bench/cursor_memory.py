@@ -0,0 +1,93 @@
+"""Memory used by the cursors of a large walk.
+
+Generates a C file, parses it and keeps every cursor of a preorder walk
+alive, then reports the growth of the resident set per cursor and the shape
+of a cursor object. Run it once per installed build to compare cursor
+layouts, see "Benchmarks" in README.md.
+
+Linux only, the resident set is read from /proc/self/statm.
+"""
+
+import argparse
+import gc
+import json
+import os
+import tempfile
+import time
+
+from pylibclang import cindex
+
+# Cursors of one generated function: the FUNCTION_DECL, two PARM_DECLs, the
+# COMPOUND_STMT, RETURN_STMT, BINARY_OPERATOR and for each operand an
+# UNEXPOSED_EXPR cast around a DECL_REF_EXPR.
+_FUNCTION = "int f%d(int a, int b) { return a + b; }\n"
+_CURSORS_PER_FUNCTION = 10
+
+
+def _rss():
+    with open("/proc/self/statm") as f:
+        return int(f.read().split()[1]) * os.sysconf("SC_PAGE_SIZE")
+
+
+def measure(num_cursors):
+    functions = max(1, num_cursors // _CURSORS_PER_FUNCTION)
+    with tempfile.NamedTemporaryFile("w", suffix=".c", delete=False) as f:
+        for i in range(functions):
+            f.write(_FUNCTION % i)
+        path = f.name
+    try:
+        tu = cindex.Index.create().parse(path)
+    finally:
+        os.unlink(path)
+
+    gc.collect()
+    before = _rss()
+    start = time.perf_counter()
+    cursors = list(tu.cursor.walk_preorder())
+    elapsed = time.perf_counter() - start
+    gc.collect()
+    grown = _rss() - before
+    cursor = cursors[-1]
+    return {
+        "cursors": len(cursors),
+        "rss_growth": grown,
+        "per_cursor": grown / len(cursors),
+        "walk_seconds": elapsed,
+        "instance_dict": hasattr(cursor, "__dict__"),
+        "gc_tracked": gc.is_tracked(cursor),
+        "basicsize": type(cursor).__basicsize__,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--cursors", type=int, default=1000000,
+                        help="approximate number of cursors to keep alive")
+    parser.add_argument("--json", help="also write the results to this file")
+    parser.add_argument("--compare",
+                        help="results of another build, written with --json")
+    opts = parser.parse_args()
+
+    result = measure(opts.cursors)
+    print("cursors:       %d" % result["cursors"])
+    print("rss growth:    %.1f MiB" % (result["rss_growth"] / 2 ** 20))
+    print("per cursor:    %.1f bytes" % result["per_cursor"])
+    print("walk:          %.2f s" % result["walk_seconds"])
+    print("instance dict: %s" % result["instance_dict"])
+    print("gc tracked:    %s" % result["gc_tracked"])
+    print("basicsize:     %d bytes" % result["basicsize"])
+    if opts.json:
+        with open(opts.json, "w") as f:
+            json.dump(result, f, indent=2)
+    if opts.compare:
+        with open(opts.compare) as f:
+            other = json.load(f)
+        print("per cursor vs %s: %+.1f bytes, walk %+.2f s" % (
+            opts.compare,
+            result["per_cursor"] - other["per_cursor"],
+            result["walk_seconds"] - other["walk_seconds"],
+        ))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,410 @@
+//
+// License: MIT
+//
+
+#ifndef PYLIBCLANG_AST_DUMP_H
+#define PYLIBCLANG_AST_DUMP_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "clang-c/Index.h"
+
+namespace ast_dump {
+
+enum class Format { kNdjson = 0, kMsgpack = 1 };
+
+/// Buffers output and hands it to write(2) in large chunks. Errors are
+/// remembered instead of thrown, since writes happen inside libclang
+/// callbacks.
+class FdWriter {
+public:
+  explicit FdWriter(int fd, size_t chunk = 1 << 16) : fd_(fd), chunk_(chunk) {
+    buf_.reserve(chunk_);
+  }
+
+  ~FdWriter() { Flush(); }
+
+  void Append(const char *p, size_t n) {
+    buf_.append(p, n);
+    if (buf_.size() >= chunk_) {
+      Flush();
+    }
+  }
+  void Append(std::string_view s) { Append(s.data(), s.size()); }
+  void Put(char c) {
+    buf_.push_back(c);
+    if (buf_.size() >= chunk_) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    size_t done = 0;
+    while (!error_ && done < buf_.size()) {
+      ssize_t n = ::write(fd_, buf_.data() + done, buf_.size() - done);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        error_ = errno;
+        break;
+      }
+      done += static_cast<size_t>(n);
+    }
+    bytes_ += done;
+    buf_.clear();
+  }
+
+  int error() const { return error_; }
+  uint64_t bytes() const { return bytes_; }
+
+private:
+  int fd_;
+  size_t chunk_;
+  std::string buf_;
+  int error_ = 0;
+  uint64_t bytes_ = 0;
+};
+
+/// Writes flat records of string keys to either NDJSON lines or MessagePack
+/// maps. The number of fields has to be known when a record begins.
+class RecordWriter {
+public:
+  RecordWriter(FdWriter &out, Format format) : out_(out), format_(format) {}
+
+  void Begin(uint32_t num_fields) {
+    first_ = true;
+    if (format_ == Format::kNdjson) {
+      out_.Put('{');
+    } else if (num_fields < 16) {
+      out_.Put(static_cast<char>(0x80 | num_fields));
+    } else {
+      out_.Put(static_cast<char>(0xde));
+      BigEndian(static_cast<uint16_t>(num_fields));
+    }
+  }
+
+  void End() {
+    if (format_ == Format::kNdjson) {
+      out_.Append("}\n", 2);
+    }
+  }
+
+  void Key(std::string_view key) {
+    if (format_ == Format::kNdjson) {
+      if (!first_) {
+        out_.Put(',');
+      }
+      first_ = false;
+      JsonString(key);
+      out_.Put(':');
+    } else {
+      MsgpackString(key);
+    }
+  }
+
+  void Str(std::string_view s) {
+    if (format_ == Format::kNdjson) {
+      JsonString(s);
+    } else {
+      MsgpackString(s);
+    }
+  }
+
+  void Int(int64_t v) {
+    if (format_ == Format::kNdjson) {
+      auto s = std::to_string(v);
+      out_.Append(s);
+    } else if (v >= 0 && v < 128) {
+      out_.Put(static_cast<char>(v));
+    } else if (v >= -32 && v < 0) {
+      out_.Put(static_cast<char>(0xe0 | (v + 32)));
+    } else if (v >= 0 && v <= UINT32_MAX) {
+      out_.Put(static_cast<char>(0xce));
+      BigEndian(static_cast<uint32_t>(v));
+    } else {
+      out_.Put(static_cast<char>(0xd3));
+      BigEndian(static_cast<uint64_t>(v));
+    }
+  }
+
+  void Null() {
+    if (format_ == Format::kNdjson) {
+      out_.Append("null", 4);
+    } else {
+      out_.Put(static_cast<char>(0xc0));
+    }
+  }
+
+  void StrArray(const std::vector<std::string> &items) {
+    if (format_ == Format::kNdjson) {
+      out_.Put('[');
+      for (size_t i = 0; i < items.size(); ++i) {
+        if (i) {
+          out_.Put(',');
+        }
+        JsonString(items[i]);
+      }
+      out_.Put(']');
+      return;
+    }
+    if (items.size() < 16) {
+      out_.Put(static_cast<char>(0x90 | items.size()));
+    } else {
+      out_.Put(static_cast<char>(0xdd));
+      BigEndian(static_cast<uint32_t>(items.size()));
+    }
+    for (auto &item : items) {
+      MsgpackString(item);
+    }
+  }
+
+private:
+  template <class T> void BigEndian(T v) {
+    char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      bytes[sizeof(T) - 1 - i] = static_cast<char>(v & 0xff);
+      v = static_cast<T>(v >> 8);
+    }
+    out_.Append(bytes, sizeof(T));
+  }
+
+  void MsgpackString(std::string_view s) {
+    if (s.size() < 32) {
+      out_.Put(static_cast<char>(0xa0 | s.size()));
+    } else if (s.size() <= UINT8_MAX) {
+      out_.Put(static_cast<char>(0xd9));
+      out_.Put(static_cast<char>(s.size()));
+    } else if (s.size() <= UINT16_MAX) {
+      out_.Put(static_cast<char>(0xda));
+      BigEndian(static_cast<uint16_t>(s.size()));
+    } else {
+      out_.Put(static_cast<char>(0xdb));
+      BigEndian(static_cast<uint32_t>(s.size()));
+    }
+    out_.Append(s);
+  }
+
+  void JsonString(std::string_view s) {
+    static const char kHex[] = "0123456789abcdef";
+    out_.Put('"');
+    size_t plain = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+      auto c = static_cast<unsigned char>(s[i]);
+      if (c >= 0x20 && c != '"' && c != '\\') {
+        continue;
+      }
+      out_.Append(s.data() + plain, i - plain);
+      plain = i + 1;
+      switch (c) {
+      case '"':
+        out_.Append("\\\"", 2);
+        break;
+      case '\\':
+        out_.Append("\\\\", 2);
+        break;
+      case '\n':
+        out_.Append("\\n", 2);
+        break;
+      case '\t':
+        out_.Append("\\t", 2);
+        break;
+      default: {
+        char esc[] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xf]};
+        out_.Append(esc, sizeof(esc));
+      }
+      }
+    }
+    out_.Append(s.data() + plain, s.size() - plain);
+    out_.Put('"');
+  }
+
+  FdWriter &out_;
+  Format format_;
+  bool first_ = true;
+};
+
+struct Options {
+  Format format = Format::kNdjson;
+  bool with_type = true;
+  bool with_usr = true;
+  bool main_file_only = false;
+  int max_depth = -1;
+};
+
+/// Streams the cursors of a subtree in preorder while visiting. Each node is
+/// written as
+///
+///   {id, parent, kind, spelling, [type], file, line, column, offset,
+///    end_line, end_column, end_offset, [usr]}
+///
+/// where `id` counts from 0 at the root and `parent` is null for the root.
+/// Only the path from the root to the current node and small caches of file
+/// names and kind spellings are kept, memory does not grow with the tree.
+class Dumper {
+public:
+  Dumper(int fd, Options options)
+      : out_(fd), records_(out_, options.format), options_(options) {}
+
+  /// Write a {"tu": filename, "args": [...]} record ahead of a dump.
+  void WriteTranslationUnit(const std::string &filename,
+                            const std::vector<std::string> &args) {
+    records_.Begin(2);
+    records_.Key("tu");
+    records_.Str(filename);
+    records_.Key("args");
+    records_.StrArray(args);
+    records_.End();
+  }
+
+  /// Dump the subtree of `root`, returns the number of nodes written.
+  uint64_t Dump(CXCursor root) {
+    uint64_t before = nodes_;
+    path_.clear();
+    path_.emplace_back(root, WriteNode(root, -1));
+    if (options_.max_depth != 0) {
+      clang_visitChildren(root, &Dumper::Visit, this);
+    }
+    out_.Flush();
+    if (out_.error()) {
+      throw std::runtime_error(std::string("ast dump: write failed: ") +
+                               std::strerror(out_.error()));
+    }
+    return nodes_ - before;
+  }
+
+  uint64_t nodes() const { return nodes_; }
+  uint64_t bytes() const { return out_.bytes(); }
+
+private:
+  static CXChildVisitResult Visit(CXCursor child, CXCursor parent,
+                                  CXClientData data) {
+    auto *self = static_cast<Dumper *>(data);
+    if (self->out_.error()) {
+      return CXChildVisit_Break;
+    }
+    if (self->options_.main_file_only &&
+        !clang_Location_isFromMainFile(clang_getCursorLocation(child))) {
+      return CXChildVisit_Continue;
+    }
+    auto &path = self->path_;
+    // Preorder guarantees the parent is on the current root-to-node path.
+    while (path.size() > 1 && !clang_equalCursors(path.back().first, parent)) {
+      path.pop_back();
+    }
+    int64_t id = self->WriteNode(child, path.back().second);
+    int depth = static_cast<int>(path.size());
+    if (self->options_.max_depth >= 0 && depth >= self->options_.max_depth) {
+      return CXChildVisit_Continue;
+    }
+    path.emplace_back(child, id);
+    return CXChildVisit_Recurse;
+  }
+
+  template <class FnT> void WithString(CXString s, FnT &&fn) {
+    const char *c_str = clang_getCString(s);
+    fn(std::string_view(c_str ? c_str : ""));
+    clang_disposeString(s);
+  }
+
+  const std::string &KindSpelling(CXCursorKind kind) {
+    auto it = kinds_.find(kind);
+    if (it == kinds_.end()) {
+      std::string spelling;
+      WithString(clang_getCursorKindSpelling(kind),
+                 [&](std::string_view s) { spelling = s; });
+      it = kinds_.emplace(kind, std::move(spelling)).first;
+    }
+    return it->second;
+  }
+
+  const std::string &FileName(CXFile f) {
+    auto it = files_.find(f);
+    if (it == files_.end()) {
+      std::string name;
+      if (f) {
+        WithString(clang_getFileName(f), [&](std::string_view s) { name = s; });
+      }
+      it = files_.emplace(f, std::move(name)).first;
+    }
+    return it->second;
+  }
+
+  int64_t WriteNode(CXCursor c, int64_t parent) {
+    int64_t id = static_cast<int64_t>(nodes_++);
+    auto &r = records_;
+    r.Begin(11 + options_.with_type + options_.with_usr);
+    r.Key("id");
+    r.Int(id);
+    r.Key("parent");
+    if (parent < 0) {
+      r.Null();
+    } else {
+      r.Int(parent);
+    }
+    r.Key("kind");
+    r.Str(KindSpelling(clang_getCursorKind(c)));
+    r.Key("spelling");
+    WithString(clang_getCursorSpelling(c),
+               [&](std::string_view s) { r.Str(s); });
+    if (options_.with_type) {
+      r.Key("type");
+      WithString(clang_getTypeSpelling(clang_getCursorType(c)),
+                 [&](std::string_view s) { r.Str(s); });
+    }
+
+    CXSourceRange extent = clang_getCursorExtent(c);
+    CXFile f;
+    unsigned line, column, offset;
+    clang_getInstantiationLocation(clang_getRangeStart(extent), &f, &line,
+                                   &column, &offset);
+    r.Key("file");
+    if (f) {
+      r.Str(FileName(f));
+    } else {
+      r.Null();
+    }
+    r.Key("line");
+    r.Int(line);
+    r.Key("column");
+    r.Int(column);
+    r.Key("offset");
+    r.Int(offset);
+    clang_getInstantiationLocation(clang_getRangeEnd(extent), nullptr, &line,
+                                   &column, &offset);
+    r.Key("end_line");
+    r.Int(line);
+    r.Key("end_column");
+    r.Int(column);
+    r.Key("end_offset");
+    r.Int(offset);
+    if (options_.with_usr) {
+      r.Key("usr");
+      WithString(clang_getCursorUSR(c), [&](std::string_view s) { r.Str(s); });
+    }
+    r.End();
+    return id;
+  }
+
+  FdWriter out_;
+  RecordWriter records_;
+  Options options_;
+  std::vector<std::pair<CXCursor, int64_t>> path_;
+  std::unordered_map<int, std::string> kinds_;
+  std::unordered_map<CXFile, std::string> files_;
+  uint64_t nodes_ = 0;
+};
+
+} // namespace ast_dump
+
+#endif // PYLIBCLANG_AST_DUMP_H
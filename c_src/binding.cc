@@ -4,7 +4,28 @@
 
 #include <pybind11/pybind11.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "_binding.cc.inc"
+#include "ast_dump.h"
+#include "completion.h"
+#include "completion_service.h"
+#include "kind_tables.h"
+#include "location_decoder.h"
+#include "parse_pool.h"
+#include "serial_executor.h"
+#include "symbol_index.h"
 
 struct StringHolder {
   StringHolder() = default;
@@ -12,6 +33,57 @@ struct StringHolder {
   std::string content;
 };
 
+/// Holder of the CXCursor and CXType Python objects. Owns the value like
+/// std::unique_ptr and has one slot for the object that keeps the value
+/// valid, its TranslationUnit, so no per-instance __dict__ is needed.
+template <class T> class TuHolder {
+public:
+  explicit TuHolder(T *p) : value_(p) {}
+  T *get() const { return value_.get(); }
+
+  pybind11::object tu;
+
+private:
+  std::unique_ptr<T> value_;
+};
+PYBIND11_DECLARE_HOLDER_TYPE(T, TuHolder<T>);
+
+/// pybind11::class_ of the generated CXCursor and CXType bindings. Drops the
+/// pybind11::dynamic_attr() the generator passes, values are held in a
+/// TuHolder instead.
+template <class T> struct SlimClass : public pybind11::class_<T, TuHolder<T>> {
+  template <class... Extra>
+  SlimClass(pybind11::handle scope, const char *name, pybind11::dynamic_attr,
+            const Extra &...extra)
+      : pybind11::class_<T, TuHolder<T>>(scope, name, extra...) {}
+};
+
+/// Expose the TuHolder slot of `cls` as `_tu`. Instances that do not own
+/// their value, e.g. a field of another struct, have no slot.
+template <class T>
+void DefTuSlot(pybind11::class_<T, TuHolder<T>> &cls) {
+  auto slot = [](pybind11::handle self) -> TuHolder<T> * {
+    auto *inst = reinterpret_cast<pybind11::detail::instance *>(self.ptr());
+    auto v_h = inst->get_value_and_holder();
+    return v_h.holder_constructed() ? &v_h.template holder<TuHolder<T>>()
+                                    : nullptr;
+  };
+  cls.def_property(
+      "_tu",
+      [slot](pybind11::handle self) -> pybind11::object {
+        auto *holder = slot(self);
+        return holder && holder->tu ? holder->tu : pybind11::none();
+      },
+      [slot](pybind11::handle self, pybind11::object tu) {
+        auto *holder = slot(self);
+        if (!holder) {
+          throw pybind11::attribute_error(
+              "object does not own its value, it has no _tu slot");
+        }
+        holder->tu = std::move(tu);
+      });
+}
+
 struct TokenArray {
   TokenArray(CXToken *beg, unsigned int n) : p(beg), n(n) {}
   CXToken *p;
@@ -19,6 +91,1684 @@ struct TokenArray {
   CXToken *at(int i) { return &p[i]; }
 };
 
+/// Stand-in for the `pybind11::module_ &` handle of a generated function
+/// binding. Every function defined through it releases the GIL while the
+/// wrapped libclang call runs, e.g. `Bind_clang_saveTranslationUnit<
+/// GilFreeModule>` binds clang_saveTranslationUnit without holding the GIL.
+struct GilFreeModule {
+  GilFreeModule(pybind11::module_ &m) : m(m) {}
+
+  template <class... Extra>
+  GilFreeModule &def(const char *name, Extra &&...extra) {
+    m.def(name, std::forward<Extra>(extra)...,
+          pybind11::call_guard<pybind11::gil_scoped_release>());
+    return *this;
+  }
+
+  operator pybind11::module_ &() { return m; }
+
+  pybind11::module_ &m;
+};
+
+namespace cxstring {
+
+/// Already converted strings of one translation unit. Once `capacity`
+/// strings are held, new strings are converted without being added.
+struct InternTable {
+  std::unordered_map<std::string, pybind11::object> strings;
+  size_t capacity = 0;
+};
+
+std::unordered_map<CXTranslationUnit, InternTable> &InternTables() {
+  // Leaked on purpose, the tables hold Python objects that must not be
+  // released after the interpreter has been finalized.
+  static auto *tables = new std::unordered_map<CXTranslationUnit, InternTable>;
+  return *tables;
+}
+
+template <class T> CXTranslationUnit OwnerTU(const T &) { return nullptr; }
+inline CXTranslationUnit OwnerTU(const CXCursor &c) {
+  return clang_Cursor_getTranslationUnit(c);
+}
+inline CXTranslationUnit
+OwnerTU(const pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> &tu) {
+  return tu ? tu->Cptr() : nullptr;
+}
+
+inline CXTranslationUnit FirstOwnerTU() { return nullptr; }
+template <class A0, class... Rest>
+CXTranslationUnit FirstOwnerTU(const A0 &a0, const Rest &...) {
+  return OwnerTU(a0);
+}
+
+/// Convert `s` to a Python str (None for a NULL string) and dispose it. When
+/// interning is enabled for `tu`, equal strings share one Python object.
+inline pybind11::object ToPyStr(CXString s, CXTranslationUnit tu) {
+  struct Disposer {
+    CXString s;
+    ~Disposer() { clang_disposeString(s); }
+  } _{s};
+  const char *c_str = clang_getCString(s);
+  if (!c_str) {
+    return pybind11::none();
+  }
+  auto &tables = InternTables();
+  if (tu && !tables.empty()) {
+    auto table = tables.find(tu);
+    if (table != tables.end()) {
+      auto &strings = table->second.strings;
+      auto it = strings.find(c_str);
+      if (it != strings.end()) {
+        return it->second;
+      }
+      pybind11::object str = pybind11::str(c_str);
+      if (strings.size() < table->second.capacity) {
+        strings.emplace(c_str, str);
+      }
+      return str;
+    }
+  }
+  return pybind11::str(c_str);
+}
+
+template <class SigT> struct StrResult;
+
+template <class... Args> struct StrResult<CXString (*)(Args...)> {
+  template <class F> static auto Wrap(F f) {
+    return [f](Args... args) {
+      // Finding the owner costs a libclang call, skip it unless some TU
+      // interns its strings.
+      auto tu = InternTables().empty() ? nullptr : FirstOwnerTU(args...);
+      return ToPyStr(f(args...), tu);
+    };
+  }
+};
+
+template <class C, class... Args>
+struct StrResult<CXString (C::*)(Args...) const>
+    : StrResult<CXString (*)(Args...)> {};
+
+template <class F> auto WrapStrResult(F f) {
+  if constexpr (std::is_pointer_v<F>) {
+    return StrResult<F>::Wrap(f);
+  } else {
+    return StrResult<decltype(&F::operator())>::Wrap(f);
+  }
+}
+
+} // namespace cxstring
+
+/// Stand-in for the `pybind11::module_ &` handle of a generated function
+/// binding returning CXString. The bound function returns a Python str
+/// instead, the CXString is disposed before returning to Python.
+struct StrResultModule {
+  StrResultModule(pybind11::module_ &m) : m(m) {}
+
+  template <class F, class... Extra>
+  StrResultModule &def(const char *name, F &&f, Extra &&...extra) {
+    m.def(name, cxstring::WrapStrResult(std::decay_t<F>(std::forward<F>(f))),
+          std::forward<Extra>(extra)...);
+    return *this;
+  }
+
+  operator pybind11::module_ &() { return m; }
+
+  pybind11::module_ &m;
+};
+
+/// Per-call state of a Python visitor, handed to libclang as `client_data`.
+/// Unlike pybind11_weaver::FnPointerWrapper it needs no global registry, so
+/// visitors may nest and run concurrently without locking. An exception raised
+/// by the Python side stops the traversal and is rethrown once libclang
+/// returns.
+template <class FnT> struct CallbackContext {
+  CallbackContext(FnT &fn, pybind11_weaver::WrappedPtrT<void *> client_data)
+      : fn(fn), client_data(std::move(client_data)) {}
+
+  template <class RetT, class... Args>
+  RetT Invoke(RetT on_error, Args &&...args) {
+    if (error) {
+      return on_error;
+    }
+    try {
+      return fn(std::forward<Args>(args)...);
+    } catch (...) {
+      error = std::current_exception();
+      return on_error;
+    }
+  }
+
+  void RethrowIfFailed() {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  FnT &fn;
+  pybind11_weaver::WrappedPtrT<void *> client_data;
+  std::exception_ptr error;
+};
+
+using ChildVisitorT = std::function<CXChildVisitResult(
+    CXCursor, CXCursor, pybind11_weaver::WrappedPtrT<void *>)>;
+using FieldVisitorT = std::function<CXVisitorResult(
+    CXCursor, pybind11_weaver::WrappedPtrT<void *>)>;
+using InclusionVisitorT = std::function<void(
+    pybind11_weaver::WrappedPtrT<void *>, const std::vector<CXSourceLocation> &,
+    unsigned int, pybind11_weaver::WrappedPtrT<void *>)>;
+using ReferenceVisitorT =
+    std::function<CXVisitorResult(CXCursor, CXSourceRange)>;
+
+unsigned int VisitChildren(CXCursor parent, ChildVisitorT &visitor,
+                           pybind11_weaver::WrappedPtrT<void *> client_data) {
+  CallbackContext<ChildVisitorT> ctx(visitor, std::move(client_data));
+  auto ret = clang_visitChildren(
+      parent,
+      [](CXCursor child, CXCursor parent, CXClientData data) {
+        auto *ctx = static_cast<CallbackContext<ChildVisitorT> *>(data);
+        return ctx->Invoke(CXChildVisit_Break, child, parent, ctx->client_data);
+      },
+      &ctx);
+  ctx.RethrowIfFailed();
+  return ret;
+}
+
+unsigned int VisitFields(CXType type, FieldVisitorT &visitor,
+                         pybind11_weaver::WrappedPtrT<void *> client_data) {
+  CallbackContext<FieldVisitorT> ctx(visitor, std::move(client_data));
+  auto ret = clang_Type_visitFields(
+      type,
+      [](CXCursor field, CXClientData data) {
+        auto *ctx = static_cast<CallbackContext<FieldVisitorT> *>(data);
+        return ctx->Invoke(CXVisit_Break, field, ctx->client_data);
+      },
+      &ctx);
+  ctx.RethrowIfFailed();
+  return ret;
+}
+
+/// The inclusion stack is only valid during the callback, it is copied into
+/// one buffer reused for the whole walk.
+struct InclusionContext : public CallbackContext<InclusionVisitorT> {
+  using CallbackContext<InclusionVisitorT>::CallbackContext;
+  std::vector<CXSourceLocation> stack;
+};
+
+void VisitInclusions(CXTranslationUnit tu, InclusionVisitorT &visitor,
+                     pybind11_weaver::WrappedPtrT<void *> client_data) {
+  InclusionContext ctx(visitor, std::move(client_data));
+  clang_getInclusions(
+      tu,
+      [](CXFile included_file, CXSourceLocation *inclusion_stack,
+         unsigned include_len, CXClientData data) {
+        auto *ctx = static_cast<InclusionContext *>(data);
+        if (ctx->error) {
+          return; // the inclusion walk can not be stopped early
+        }
+        ctx->stack.assign(inclusion_stack, inclusion_stack + include_len);
+        try {
+          ctx->fn(pybind11_weaver::WrapP<void *>(included_file), ctx->stack,
+                  include_len, ctx->client_data);
+        } catch (...) {
+          ctx->error = std::current_exception();
+        }
+      },
+      &ctx);
+  ctx.RethrowIfFailed();
+}
+
+CXResult FindReferencesInFile(CXCursor cursor, CXFile file,
+                              ReferenceVisitorT &visitor) {
+  CallbackContext<ReferenceVisitorT> ctx(visitor, nullptr);
+  CXCursorAndRangeVisitor c_visitor{
+      &ctx, [](void *data, CXCursor ref, CXSourceRange range) {
+        auto *ctx = static_cast<CallbackContext<ReferenceVisitorT> *>(data);
+        return ctx->Invoke(CXVisit_Break, ref, range);
+      }};
+  auto ret = clang_findReferencesInFile(cursor, file, c_visitor);
+  ctx.RethrowIfFailed();
+  return ret;
+}
+
+std::string FileName(CXFile f) {
+  if (!f) {
+    return std::string();
+  }
+  CXString name = clang_getFileName(f);
+  const char *c_name = clang_getCString(name);
+  std::string out(c_name ? c_name : "");
+  clang_disposeString(name);
+  return out;
+}
+
+/// (device, inode, mtime) of `f`, empty when clang can not identify it.
+std::optional<std::tuple<unsigned long long, unsigned long long,
+                         unsigned long long>>
+FileUniqueID(CXFile f) {
+  CXFileUniqueID id;
+  if (!f || clang_getFileUniqueID(f, &id) != 0) {
+    return std::nullopt;
+  }
+  return std::make_tuple(id.data[0], id.data[1], id.data[2]);
+}
+
+/// One edge of the inclusion graph of a translation unit. The main file is
+/// reported with an empty `includer` and depth 0.
+struct Inclusion {
+  std::string file;
+  std::string includer;
+  unsigned depth;
+  decltype(FileUniqueID(nullptr)) unique_id;
+};
+
+std::vector<Inclusion> CollectInclusions(CXTranslationUnit tu) {
+  std::vector<Inclusion> out;
+  clang_getInclusions(
+      tu,
+      [](CXFile included_file, CXSourceLocation *inclusion_stack,
+         unsigned include_len, CXClientData data) {
+        auto *out = static_cast<std::vector<Inclusion> *>(data);
+        CXFile includer = nullptr;
+        if (include_len) {
+          clang_getInstantiationLocation(inclusion_stack[0], &includer,
+                                         nullptr, nullptr, nullptr);
+        }
+        out->push_back({FileName(included_file), FileName(includer),
+                        include_len, FileUniqueID(included_file)});
+      },
+      &out);
+  return out;
+}
+
+/// Preorder snapshot of a cursor subtree, built by a single
+/// clang_visitChildren pass. Entry 0 is the root cursor itself.
+struct CursorWalk {
+  std::vector<CXCursor> cursors;
+  std::vector<int> parents; // index into `cursors`, -1 for the root
+  std::vector<int> depths;  // root is at depth 0
+
+  size_t size() const { return cursors.size(); }
+  CXCursor at(size_t i) const { return cursors.at(i); }
+  int parent(size_t i) const { return parents.at(i); }
+  int depth(size_t i) const { return depths.at(i); }
+};
+
+namespace walk_detail {
+
+struct WalkState {
+  CursorWalk *out;
+  int max_depth;
+  // indices of the cursors on the path from the root to the last visited node
+  std::vector<int> stack;
+};
+
+CXChildVisitResult Visit(CXCursor child, CXCursor parent, CXClientData data) {
+  auto *state = static_cast<WalkState *>(data);
+  auto &out = *state->out;
+  // Preorder guarantees the parent is on the current root-to-node path.
+  while (state->stack.size() > 1 &&
+         !clang_equalCursors(out.cursors[state->stack.back()], parent)) {
+    state->stack.pop_back();
+  }
+  int parent_idx = state->stack.back();
+  int depth = out.depths[parent_idx] + 1;
+  int idx = static_cast<int>(out.cursors.size());
+  out.cursors.push_back(child);
+  out.parents.push_back(parent_idx);
+  out.depths.push_back(depth);
+  if (state->max_depth >= 0 && depth >= state->max_depth) {
+    return CXChildVisit_Continue;
+  }
+  state->stack.push_back(idx);
+  return CXChildVisit_Recurse;
+}
+
+} // namespace walk_detail
+
+/// Walk the subtree rooted at `root` in preorder. A negative `max_depth` means
+/// unlimited, `max_depth == 1` collects the direct children only.
+CursorWalk WalkSubtree(CXCursor root, int max_depth) {
+  CursorWalk out;
+  out.cursors.push_back(root);
+  out.parents.push_back(-1);
+  out.depths.push_back(0);
+  if (max_depth == 0) {
+    return out;
+  }
+  walk_detail::WalkState state{&out, max_depth, {0}};
+  clang_visitChildren(root, &walk_detail::Visit, &state);
+  return out;
+}
+
+/// Assigns dense ids to strings, id 0 is always the empty string.
+struct StringInterner {
+  StringInterner() { Intern(std::string()); }
+
+  int32_t Intern(std::string s) {
+    auto it = ids.find(s);
+    if (it != ids.end()) {
+      return it->second;
+    }
+    auto id = static_cast<int32_t>(strings.size());
+    ids.emplace(s, id);
+    strings.push_back(std::move(s));
+    return id;
+  }
+
+  /// Intern and dispose a CXString.
+  int32_t Intern(CXString s) {
+    const char *c_str = clang_getCString(s);
+    auto id = Intern(std::string(c_str ? c_str : ""));
+    clang_disposeString(s);
+    return id;
+  }
+
+  std::unordered_map<std::string, int32_t> ids;
+  std::vector<std::string> strings;
+};
+
+/// Struct-of-arrays view of a cursor subtree in preorder, entry 0 is the root.
+/// Locations are instantiation locations of the cursor extent, nodes without
+/// a file have `file == -1`.
+struct AstColumns {
+  std::vector<int32_t> kind;
+  std::vector<int32_t> parent;
+  std::vector<int32_t> depth;
+  std::vector<int32_t> file;
+  std::vector<int32_t> line;
+  std::vector<int32_t> column;
+  std::vector<int32_t> offset;
+  std::vector<int32_t> end_offset;
+  std::vector<int32_t> usr;      // id into `usrs`
+  std::vector<int32_t> spelling; // id into `spellings`
+  std::vector<std::string> files;
+  StringInterner usrs;
+  StringInterner spellings;
+
+  size_t size() const { return kind.size(); }
+};
+
+std::shared_ptr<AstColumns> ExportAstColumns(CXCursor root, bool with_usr,
+                                             bool with_spelling) {
+  auto walk = WalkSubtree(root, -1);
+  auto cols = std::make_shared<AstColumns>();
+  size_t n = walk.size();
+  for (auto *col : {&cols->kind, &cols->parent, &cols->depth, &cols->file,
+                    &cols->line, &cols->column, &cols->offset,
+                    &cols->end_offset, &cols->usr, &cols->spelling}) {
+    col->resize(n, 0);
+  }
+  std::unordered_map<CXFile, int32_t> file_ids;
+  auto file_id = [&](CXFile f) -> int32_t {
+    if (!f) {
+      return -1;
+    }
+    auto it = file_ids.find(f);
+    if (it != file_ids.end()) {
+      return it->second;
+    }
+    auto id = static_cast<int32_t>(cols->files.size());
+    CXString name = clang_getFileName(f);
+    const char *c_name = clang_getCString(name);
+    cols->files.emplace_back(c_name ? c_name : "");
+    clang_disposeString(name);
+    file_ids.emplace(f, id);
+    return id;
+  };
+
+  for (size_t i = 0; i < n; ++i) {
+    CXCursor c = walk.cursors[i];
+    cols->kind[i] = clang_getCursorKind(c);
+    cols->parent[i] = walk.parents[i];
+    cols->depth[i] = walk.depths[i];
+
+    CXSourceRange extent = clang_getCursorExtent(c);
+    CXFile f;
+    unsigned line, column, offset;
+    clang_getInstantiationLocation(clang_getRangeStart(extent), &f, &line,
+                                   &column, &offset);
+    cols->file[i] = file_id(f);
+    cols->line[i] = static_cast<int32_t>(line);
+    cols->column[i] = static_cast<int32_t>(column);
+    cols->offset[i] = static_cast<int32_t>(offset);
+    clang_getInstantiationLocation(clang_getRangeEnd(extent), nullptr, nullptr,
+                                   nullptr, &offset);
+    cols->end_offset[i] = static_cast<int32_t>(offset);
+
+    if (with_usr) {
+      cols->usr[i] = cols->usrs.Intern(clang_getCursorUSR(c));
+    }
+    if (with_spelling) {
+      cols->spelling[i] = cols->spellings.Intern(clang_getCursorSpelling(c));
+    }
+  }
+  return cols;
+}
+
+/// A read-only int32 column exposed through the Python buffer protocol. It
+/// keeps its owner alive, so numpy/memoryview views never dangle.
+template <class OwnerT> struct Int32Column {
+  std::shared_ptr<OwnerT> owner;
+  const std::vector<int32_t> *data;
+
+  pybind11::buffer_info Buffer() const {
+    return pybind11::buffer_info(
+        const_cast<int32_t *>(data->data()), sizeof(int32_t),
+        pybind11::format_descriptor<int32_t>::format(), 1,
+        {static_cast<pybind11::ssize_t>(data->size())},
+        {static_cast<pybind11::ssize_t>(sizeof(int32_t))}, true);
+  }
+};
+
+template <class OwnerT>
+void BindInt32Column(pybind11::module_ &m, const char *name) {
+  using ColumnT = Int32Column<OwnerT>;
+  pybind11::class_<ColumnT>(m, name, pybind11::buffer_protocol())
+      .def_buffer(&ColumnT::Buffer)
+      .def("__len__", [](const ColumnT &self) { return self.data->size(); })
+      .def("__getitem__", [](const ColumnT &self, size_t i) {
+        if (i >= self.data->size()) {
+          throw pybind11::index_error();
+        }
+        return (*self.data)[i];
+      });
+}
+
+/// Bind `attr` of `ClassT` as a property returning an Int32Column view.
+template <class ClassT, class PyClassT>
+void DefInt32Column(PyClassT &cls, const char *name,
+                    std::vector<int32_t> ClassT::*attr) {
+  cls.def_property_readonly(name, [attr](std::shared_ptr<ClassT> self) {
+    return Int32Column<ClassT>{self, &((*self).*attr)};
+  });
+}
+
+/// All tokens of a range as columns, in source order. Spellings are stored
+/// back to back in `text`, token `i` spans
+/// `text[spelling_offset[i], spelling_offset[i + 1])`.
+struct PackedTokens {
+  std::vector<int32_t> kind;
+  std::vector<int32_t> offset;
+  std::vector<int32_t> end_offset;
+  std::vector<int32_t> line;
+  std::vector<int32_t> column;
+  std::vector<int32_t> spelling_offset;
+  std::string text;
+
+  size_t size() const { return kind.size(); }
+  std::string_view spelling(size_t i) const {
+    auto beg = static_cast<size_t>(spelling_offset.at(i));
+    auto end = static_cast<size_t>(spelling_offset.at(i + 1));
+    return std::string_view(text).substr(beg, end - beg);
+  }
+};
+
+std::shared_ptr<PackedTokens> PackTokens(CXTranslationUnit tu,
+                                         const TokenArray &tokens) {
+  auto packed = std::make_shared<PackedTokens>();
+  for (auto *col : {&packed->kind, &packed->offset, &packed->end_offset,
+                    &packed->line, &packed->column}) {
+    col->resize(tokens.n, 0);
+  }
+  packed->spelling_offset.resize(tokens.n + 1, 0);
+
+  CXFile buffer_file = nullptr;
+  const char *buffer = nullptr;
+  size_t buffer_size = 0;
+  for (unsigned i = 0; i < tokens.n; ++i) {
+    CXToken tok = tokens.p[i];
+    packed->kind[i] = clang_getTokenKind(tok);
+    CXSourceRange extent = clang_getTokenExtent(tu, tok);
+    CXFile f;
+    unsigned line, column, offset, end_offset;
+    clang_getInstantiationLocation(clang_getRangeStart(extent), &f, &line,
+                                   &column, &offset);
+    clang_getInstantiationLocation(clang_getRangeEnd(extent), nullptr, nullptr,
+                                   nullptr, &end_offset);
+    packed->offset[i] = static_cast<int32_t>(offset);
+    packed->end_offset[i] = static_cast<int32_t>(end_offset);
+    packed->line[i] = static_cast<int32_t>(line);
+    packed->column[i] = static_cast<int32_t>(column);
+
+    if (f != buffer_file) {
+      buffer_file = f;
+      buffer = f ? clang_getFileContents(tu, f, &buffer_size) : nullptr;
+    }
+    // Slicing the file buffer avoids a CXString per token, escaped newlines
+    // inside a token still need clang to compute the spelling.
+    std::string_view raw;
+    if (buffer && offset <= end_offset && end_offset <= buffer_size) {
+      raw = std::string_view(buffer + offset, end_offset - offset);
+    }
+    if (!raw.empty() && raw.find('\\') == std::string_view::npos) {
+      packed->text.append(raw);
+    } else {
+      CXString sp = clang_getTokenSpelling(tu, tok);
+      const char *c_sp = clang_getCString(sp);
+      packed->text.append(c_sp ? c_sp : "");
+      clang_disposeString(sp);
+    }
+    packed->spelling_offset[i + 1] = static_cast<int32_t>(packed->text.size());
+  }
+  return packed;
+}
+
+/// Cursors of `n` tokens starting at `tokens`, annotated by a single
+/// clang_annotateTokens call.
+std::vector<CXCursor> AnnotateTokens(CXTranslationUnit tu, CXToken *tokens,
+                                     unsigned n) {
+  std::vector<CXCursor> cursors(n);
+  if (n) {
+    clang_annotateTokens(tu, tokens, n, cursors.data());
+  }
+  return cursors;
+}
+
+/// Packed tokens of a range along with the kind of the cursor each token
+/// annotates and the USR id of the entity that cursor references (0 when it
+/// references nothing).
+struct AnnotatedTokens {
+  std::shared_ptr<PackedTokens> tokens;
+  std::vector<int32_t> cursor_kind;
+  std::vector<int32_t> usr;
+  StringInterner usrs;
+
+  size_t size() const { return cursor_kind.size(); }
+};
+
+std::shared_ptr<AnnotatedTokens>
+AnnotateRangePacked(CXTranslationUnit tu, CXSourceRange range, bool with_usr) {
+  CXToken *tokens;
+  unsigned int num_tokens;
+  clang_tokenize(tu, range, &tokens, &num_tokens);
+  auto out = std::make_shared<AnnotatedTokens>();
+  out->tokens = PackTokens(tu, TokenArray(tokens, num_tokens));
+  auto cursors = AnnotateTokens(tu, tokens, num_tokens);
+  if (num_tokens) {
+    clang_disposeTokens(tu, tokens, num_tokens);
+  }
+
+  out->cursor_kind.resize(num_tokens, 0);
+  out->usr.resize(num_tokens, 0);
+  // Many tokens refer to the same declaration, compute each USR once.
+  std::unordered_map<unsigned, std::vector<std::pair<CXCursor, int32_t>>>
+      usr_cache;
+  for (unsigned i = 0; i < num_tokens; ++i) {
+    out->cursor_kind[i] = clang_getCursorKind(cursors[i]);
+    if (!with_usr) {
+      continue;
+    }
+    CXCursor ref = clang_getCursorReferenced(cursors[i]);
+    if (clang_Cursor_isNull(ref)) {
+      continue;
+    }
+    auto &bucket = usr_cache[clang_hashCursor(ref)];
+    auto it = std::find_if(bucket.begin(), bucket.end(), [&](auto &entry) {
+      return clang_equalCursors(entry.first, ref);
+    });
+    if (it == bucket.end()) {
+      bucket.emplace_back(ref, out->usrs.Intern(clang_getCursorUSR(ref)));
+      it = std::prev(bucket.end());
+    }
+    out->usr[i] = it->second;
+  }
+  return out;
+}
+
+/// Bits of IndexRecords::flags.
+enum IndexRecordFlag : int32_t {
+  kIndexRecordDefinition = 1 << 0,
+  kIndexRecordRedeclaration = 1 << 1,
+  kIndexRecordImplicit = 1 << 2,
+  kIndexRecordContainer = 1 << 3,
+  kIndexRecordSkipped = 1 << 4, // body skipped, see SkipParsedBodiesInSession
+};
+
+/// Declarations and entity references reported by the libclang indexer,
+/// stored as columns in callback order.
+///
+/// `usr`, `name` and `container` are ids into `usrs`/`names`, `container` is
+/// the USR id of the semantic container of a declaration or of the container
+/// of a reference, 0 at translation unit scope. `role` holds CXSymbolRole
+/// bits, declarations get Declaration and, for definitions, Definition.
+struct IndexRecords {
+  std::vector<int32_t> is_reference;
+  std::vector<int32_t> entity_kind;
+  std::vector<int32_t> usr;
+  std::vector<int32_t> name;
+  std::vector<int32_t> file;
+  std::vector<int32_t> line;
+  std::vector<int32_t> column;
+  std::vector<int32_t> offset;
+  std::vector<int32_t> container;
+  std::vector<int32_t> role;
+  std::vector<int32_t> flags;
+  std::vector<std::string> files;
+  StringInterner usrs;
+  StringInterner names;
+
+  size_t size() const { return usr.size(); }
+};
+
+/// IndexerCallbacks filling an IndexRecords without calling into Python, so
+/// the indexer can run with the GIL released.
+///
+/// File ids are handed to libclang as CXIdxClientFile and container USR ids
+/// as CXIdxClientContainer, which keeps string work per event to the USR of
+/// the entity itself. Events located in a file of `skip_files` (other than
+/// the main file) are counted as duplicates instead of being recorded.
+class IndexCollector {
+public:
+  explicit IndexCollector(
+      bool with_references,
+      const std::unordered_set<std::string> *skip_files = nullptr)
+      : records_(std::make_shared<IndexRecords>()),
+        with_references_(with_references), skip_files_(skip_files) {}
+
+  static IndexerCallbacks Callbacks() {
+    IndexerCallbacks cb = {};
+    cb.enteredMainFile = [](CXClientData data, CXFile file, void *) {
+      auto *self = Self(data);
+      int32_t id = self->FileId(file);
+      if (id >= 0) {
+        self->suppressed_[id] = false;
+      }
+      return ClientFile(id);
+    };
+    cb.ppIncludedFile = [](CXClientData data,
+                           const CXIdxIncludedFileInfo *info) {
+      return ClientFile(Self(data)->FileId(info->file));
+    };
+    cb.indexDeclaration = [](CXClientData data, const CXIdxDeclInfo *info) {
+      Self(data)->OnDeclaration(info);
+    };
+    cb.indexEntityReference = [](CXClientData data,
+                                 const CXIdxEntityRefInfo *info) {
+      Self(data)->OnReference(info);
+    };
+    return cb;
+  }
+
+  std::shared_ptr<IndexRecords> records() const { return records_; }
+
+  /// Events dropped because they are located in a skipped file.
+  uint64_t duplicates() const { return duplicates_; }
+
+  /// Number of files of this translation unit found in `skip_files`.
+  size_t SkippedFiles() const {
+    return static_cast<size_t>(
+        std::count(suppressed_.begin(), suppressed_.end(), true));
+  }
+
+  int32_t FileId(CXFile f) {
+    if (!f) {
+      return -1;
+    }
+    auto it = file_ids_.find(f);
+    if (it != file_ids_.end()) {
+      return it->second;
+    }
+    // Each translation unit has its own CXFile for a shared header, the name
+    // keeps one id per file.
+    auto name = FileName(f);
+    auto by_name = name_ids_.find(name);
+    int32_t id;
+    if (by_name != name_ids_.end()) {
+      id = by_name->second;
+    } else {
+      id = static_cast<int32_t>(records_->files.size());
+      suppressed_.push_back(skip_files_ && skip_files_->count(name));
+      records_->files.push_back(name);
+      name_ids_.emplace(std::move(name), id);
+    }
+    file_ids_.emplace(f, id);
+    return id;
+  }
+
+protected:
+  struct Location {
+    int32_t file;
+    unsigned line, column, offset;
+  };
+
+  static IndexCollector *Self(CXClientData data) {
+    return static_cast<IndexCollector *>(data);
+  }
+
+  static CXIdxClientFile ClientFile(int32_t id) {
+    return reinterpret_cast<CXIdxClientFile>(static_cast<intptr_t>(id) + 1);
+  }
+
+  static int32_t ContainerId(const CXIdxContainerInfo *container) {
+    if (!container) {
+      return 0;
+    }
+    return static_cast<int32_t>(reinterpret_cast<intptr_t>(
+        clang_index_getClientContainer(container)));
+  }
+
+  Location Resolve(CXIdxLoc loc) {
+    Location out;
+    CXIdxClientFile client_file;
+    CXFile f;
+    clang_indexLoc_getFileLocation(loc, &client_file, &f, &out.line,
+                                   &out.column, &out.offset);
+    if (client_file) {
+      out.file =
+          static_cast<int32_t>(reinterpret_cast<intptr_t>(client_file)) - 1;
+    } else {
+      out.file = FileId(f);
+    }
+    return out;
+  }
+
+  bool Suppressed(const Location &loc) {
+    if (loc.file >= 0 && suppressed_[loc.file]) {
+      ++duplicates_;
+      return true;
+    }
+    return false;
+  }
+
+  int32_t InternUsr(const CXIdxEntityInfo *entity) {
+    if (!entity) {
+      return 0;
+    }
+    return records_->usrs.Intern(std::string(entity->USR ? entity->USR : ""));
+  }
+
+  void OnDeclaration(const CXIdxDeclInfo *info) {
+    Location loc = Resolve(info->loc);
+    int32_t usr = InternUsr(info->entityInfo);
+    if (info->declAsContainer) {
+      // Needed even for dropped declarations, references in new files may
+      // still be contained in them.
+      clang_index_setClientContainer(
+          info->declAsContainer,
+          reinterpret_cast<CXIdxClientContainer>(static_cast<intptr_t>(usr)));
+    }
+    if (Suppressed(loc)) {
+      return;
+    }
+    int32_t role = CXSymbolRole_Declaration;
+    if (info->isDefinition) {
+      role |= CXSymbolRole_Definition;
+    }
+    Append(0, info->entityInfo, usr, loc, ContainerId(info->semanticContainer),
+           role);
+    auto &flags = records_->flags.back();
+    flags |= info->isDefinition ? kIndexRecordDefinition : 0;
+    flags |= info->isRedeclaration ? kIndexRecordRedeclaration : 0;
+    flags |= info->isImplicit ? kIndexRecordImplicit : 0;
+    flags |= info->isContainer ? kIndexRecordContainer : 0;
+    flags |= (info->flags & CXIdxDeclFlag_Skipped) ? kIndexRecordSkipped : 0;
+  }
+
+  void OnReference(const CXIdxEntityRefInfo *info) {
+    if (!with_references_) {
+      return;
+    }
+    Location loc = Resolve(info->loc);
+    if (Suppressed(loc)) {
+      return;
+    }
+    Append(1, info->referencedEntity, InternUsr(info->referencedEntity), loc,
+           ContainerId(info->container), info->role);
+    if (info->kind == CXIdxEntityRef_Implicit) {
+      records_->flags.back() |= kIndexRecordImplicit;
+    }
+  }
+
+  void Append(int32_t is_reference, const CXIdxEntityInfo *entity,
+              int32_t usr, const Location &loc, int32_t container,
+              int32_t role) {
+    auto &r = *records_;
+    if (entity) {
+      r.entity_kind.push_back(entity->kind);
+      r.name.push_back(
+          r.names.Intern(std::string(entity->name ? entity->name : "")));
+    } else {
+      r.entity_kind.push_back(CXIdxEntity_Unexposed);
+      r.name.push_back(0);
+    }
+    r.is_reference.push_back(is_reference);
+    r.usr.push_back(usr);
+    r.file.push_back(loc.file);
+    r.line.push_back(static_cast<int32_t>(loc.line));
+    r.column.push_back(static_cast<int32_t>(loc.column));
+    r.offset.push_back(static_cast<int32_t>(loc.offset));
+    r.container.push_back(container);
+    r.role.push_back(role);
+    r.flags.push_back(0);
+  }
+
+  std::shared_ptr<IndexRecords> records_;
+  bool with_references_;
+  const std::unordered_set<std::string> *skip_files_;
+  std::unordered_map<CXFile, int32_t> file_ids_;
+  std::unordered_map<std::string, int32_t> name_ids_;
+  std::vector<bool> suppressed_; // by file id
+  uint64_t duplicates_ = 0;
+};
+
+/// Indexes many files with one CXIndexAction, so libclang can skip bodies it
+/// already parsed in the session (CXIndexOpt_SkipParsedBodiesInSession).
+/// Declarations and references located in headers indexed for an earlier
+/// file are dropped and counted as duplicates. IndexFile() runs without the
+/// GIL, calls from several threads are serialized by the session.
+class IndexSession {
+public:
+  IndexSession(CXIndex index, unsigned index_options, bool with_references)
+      : action_(clang_IndexAction_create(index)),
+        index_options_(index_options), with_references_(with_references) {}
+
+  IndexSession(const IndexSession &) = delete;
+  IndexSession &operator=(const IndexSession &) = delete;
+
+  ~IndexSession() { clang_IndexAction_dispose(action_); }
+
+  std::pair<std::shared_ptr<IndexRecords>, int>
+  IndexFile(const std::string &filename, const std::vector<std::string> &args,
+            bool full_argv, std::vector<CXUnsavedFile> &unsaved_files,
+            unsigned tu_options) {
+    // The action and seen_files_ are used through the whole call.
+    std::lock_guard<std::mutex> session_lock(session_mu_);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<const char *> c_args;
+    for (auto &a : args) {
+      c_args.push_back(a.c_str());
+    }
+    IndexCollector collector(with_references_, &seen_files_);
+    IndexerCallbacks cb = IndexCollector::Callbacks();
+    int err;
+    if (full_argv) {
+      err = clang_indexSourceFileFullArgv(
+          action_, &collector, &cb, sizeof(cb), index_options_, nullptr,
+          c_args.data(), static_cast<int>(c_args.size()), unsaved_files.data(),
+          unsaved_files.size(), nullptr, tu_options);
+    } else {
+      err = clang_indexSourceFile(
+          action_, &collector, &cb, sizeof(cb), index_options_,
+          filename.empty() ? nullptr : filename.c_str(), c_args.data(),
+          static_cast<int>(c_args.size()), unsaved_files.data(),
+          unsaved_files.size(), nullptr, tu_options);
+    }
+    auto records = collector.records();
+    std::lock_guard<std::mutex> _(stats_mu_);
+    if (err == 0) {
+      seen_files_.insert(records->files.begin(), records->files.end());
+    }
+    ++files_;
+    errors_ += err != 0;
+    records_ += records->size();
+    duplicates_ += collector.duplicates();
+    skipped_files_ += collector.SkippedFiles();
+    seconds_ += std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    return {records, err};
+  }
+
+  // The statistics only wait for a running IndexFile() to finish its
+  // bookkeeping, not for the indexing.
+  size_t Files() const { return Stat(files_); }
+  size_t Errors() const { return Stat(errors_); }
+  size_t SeenFiles() const {
+    std::lock_guard<std::mutex> _(stats_mu_);
+    return seen_files_.size();
+  }
+  uint64_t Records() const { return Stat(records_); }
+  uint64_t Duplicates() const { return Stat(duplicates_); }
+  uint64_t SkippedFiles() const { return Stat(skipped_files_); }
+  double Seconds() const { return Stat(seconds_); }
+
+private:
+  template <class T> T Stat(const T &field) const {
+    std::lock_guard<std::mutex> _(stats_mu_);
+    return field;
+  }
+
+  std::mutex session_mu_;
+  // Guards seen_files_ writes and the counters below.
+  mutable std::mutex stats_mu_;
+  CXIndexAction action_;
+  unsigned index_options_;
+  bool with_references_;
+  std::unordered_set<std::string> seen_files_;
+  size_t files_ = 0;
+  size_t errors_ = 0;
+  uint64_t records_ = 0;
+  uint64_t duplicates_ = 0;
+  uint64_t skipped_files_ = 0;
+  double seconds_ = 0;
+};
+
+const symbol_index::Reader &CheckedReader(const symbol_index::Reader &r) {
+  if (r.Closed()) {
+    throw std::runtime_error("symbol index is closed");
+  }
+  return r;
+}
+
+std::vector<std::string_view>
+TableStrings(const symbol_index::StringTable &table) {
+  std::vector<std::string_view> out;
+  for (uint32_t i = 0; i < table.size(); ++i) {
+    out.push_back(table.at(i));
+  }
+  return out;
+}
+
+/// Add the named declarations and references of `records` to `unit`,
+/// replacing what `unit` held before. Only records with a role in
+/// `role_mask` are kept, all when it is 0.
+void AddIndexRecords(symbol_index::Builder &builder, const std::string &unit,
+                     const IndexRecords &records, uint32_t role_mask) {
+  std::vector<uint32_t> usrs(records.usrs.strings.size());
+  for (size_t i = 0; i < usrs.size(); ++i) {
+    usrs[i] = builder.InternUsr(records.usrs.strings[i]);
+  }
+  std::vector<uint32_t> files(records.files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    files[i] = builder.InternFile(records.files[i]);
+  }
+  auto &entries = builder.ResetUnit(unit);
+  for (size_t i = 0; i < records.size(); ++i) {
+    auto role = static_cast<uint32_t>(records.role[i]);
+    if (records.usr[i] == 0 || records.file[i] < 0 ||
+        (role_mask && !(role & role_mask))) {
+      continue;
+    }
+    symbol_index::Posting p{};
+    p.file = files[records.file[i]];
+    p.line = static_cast<uint32_t>(records.line[i]);
+    p.column = static_cast<uint32_t>(records.column[i]);
+    p.offset = static_cast<uint32_t>(records.offset[i]);
+    p.role = role;
+    entries.push_back({usrs[records.usr[i]], p});
+  }
+}
+
+/// Add the cursors of `cols` that have a USR to `unit` as declarations,
+/// replacing what `unit` held before.
+void AddAstColumns(symbol_index::Builder &builder, const std::string &unit,
+                   const AstColumns &cols) {
+  std::vector<uint32_t> usrs(cols.usrs.strings.size());
+  for (size_t i = 0; i < usrs.size(); ++i) {
+    usrs[i] = builder.InternUsr(cols.usrs.strings[i]);
+  }
+  std::vector<uint32_t> files(cols.files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    files[i] = builder.InternFile(cols.files[i]);
+  }
+  auto &entries = builder.ResetUnit(unit);
+  for (size_t i = 0; i < cols.size(); ++i) {
+    if (cols.usr[i] == 0 || cols.file[i] < 0) {
+      continue;
+    }
+    symbol_index::Posting p{};
+    p.file = files[cols.file[i]];
+    p.line = static_cast<uint32_t>(cols.line[i]);
+    p.column = static_cast<uint32_t>(cols.column[i]);
+    p.offset = static_cast<uint32_t>(cols.offset[i]);
+    p.role = CXSymbolRole_Declaration;
+    entries.push_back({usrs[cols.usr[i]], p});
+  }
+}
+
+/// Diagnostics flattened into columns, in the order libclang reports them.
+/// Child notes follow their parent with `parent` set to its row, top-level
+/// diagnostics have `parent == -1`.
+///
+/// Source ranges and fix-its are rows of a second table of spans, ordered by
+/// `span_diagnostic`. Fix-its have `span_is_fixit == 1` and their
+/// replacement in `span_text`. Locations are expansion locations, `file` ids
+/// index into `files` and are -1 for no file. `message`, `option`,
+/// `disable_option`, `category_name` and `span_text` are ids into `strings`.
+struct PackedDiagnostics {
+  std::vector<int32_t> severity;
+  std::vector<int32_t> category;
+  std::vector<int32_t> category_name;
+  std::vector<int32_t> option;
+  std::vector<int32_t> disable_option;
+  std::vector<int32_t> message;
+  std::vector<int32_t> parent;
+  std::vector<int32_t> file;
+  std::vector<int32_t> line;
+  std::vector<int32_t> column;
+  std::vector<int32_t> offset;
+
+  std::vector<int32_t> span_diagnostic;
+  std::vector<int32_t> span_is_fixit;
+  std::vector<int32_t> span_file;
+  std::vector<int32_t> span_line;
+  std::vector<int32_t> span_column;
+  std::vector<int32_t> span_offset;
+  std::vector<int32_t> span_end_line;
+  std::vector<int32_t> span_end_column;
+  std::vector<int32_t> span_end_offset;
+  std::vector<int32_t> span_text;
+
+  std::vector<std::string> files;
+  StringInterner strings;
+
+  size_t size() const { return severity.size(); }
+  size_t num_spans() const { return span_diagnostic.size(); }
+};
+
+/// Appends every diagnostic of a CXDiagnosticSet, and their children, to a
+/// PackedDiagnostics.
+class DiagnosticPacker {
+public:
+  DiagnosticPacker() : out_(std::make_shared<PackedDiagnostics>()) {}
+
+  void AddSet(CXDiagnosticSet set, int32_t parent = -1) {
+    unsigned n = clang_getNumDiagnosticsInSet(set);
+    for (unsigned i = 0; i < n; ++i) {
+      CXDiagnostic d = clang_getDiagnosticInSet(set, i);
+      if (!d) {
+        continue;
+      }
+      Add(d, parent);
+      clang_disposeDiagnostic(d);
+    }
+  }
+
+  std::shared_ptr<PackedDiagnostics> Take() { return std::move(out_); }
+
+private:
+  void Add(CXDiagnostic d, int32_t parent) {
+    auto &out = *out_;
+    auto row = static_cast<int32_t>(out.size());
+    out.severity.push_back(clang_getDiagnosticSeverity(d));
+    out.category.push_back(
+        static_cast<int32_t>(clang_getDiagnosticCategory(d)));
+    out.category_name.push_back(
+        out.strings.Intern(clang_getDiagnosticCategoryText(d)));
+    CXString disable;
+    out.option.push_back(
+        out.strings.Intern(clang_getDiagnosticOption(d, &disable)));
+    out.disable_option.push_back(out.strings.Intern(disable));
+    out.message.push_back(out.strings.Intern(clang_getDiagnosticSpelling(d)));
+    out.parent.push_back(parent);
+    unsigned line, column, offset;
+    out.file.push_back(Locate(clang_getDiagnosticLocation(d), &line, &column,
+                              &offset));
+    out.line.push_back(static_cast<int32_t>(line));
+    out.column.push_back(static_cast<int32_t>(column));
+    out.offset.push_back(static_cast<int32_t>(offset));
+
+    unsigned num_ranges = clang_getDiagnosticNumRanges(d);
+    for (unsigned i = 0; i < num_ranges; ++i) {
+      AddSpan(row, clang_getDiagnosticRange(d, i), 0);
+    }
+    unsigned num_fixits = clang_getDiagnosticNumFixIts(d);
+    for (unsigned i = 0; i < num_fixits; ++i) {
+      CXSourceRange range;
+      CXString text = clang_getDiagnosticFixIt(d, i, &range);
+      AddSpan(row, range, out.strings.Intern(text));
+      out.span_is_fixit.back() = 1;
+    }
+
+    if (CXDiagnosticSet children = clang_getChildDiagnostics(d)) {
+      AddSet(children, row);
+    }
+  }
+
+  void AddSpan(int32_t row, CXSourceRange range, int32_t text) {
+    auto &out = *out_;
+    unsigned line, column, offset;
+    out.span_diagnostic.push_back(row);
+    out.span_is_fixit.push_back(0);
+    out.span_file.push_back(
+        Locate(clang_getRangeStart(range), &line, &column, &offset));
+    out.span_line.push_back(static_cast<int32_t>(line));
+    out.span_column.push_back(static_cast<int32_t>(column));
+    out.span_offset.push_back(static_cast<int32_t>(offset));
+    Locate(clang_getRangeEnd(range), &line, &column, &offset);
+    out.span_end_line.push_back(static_cast<int32_t>(line));
+    out.span_end_column.push_back(static_cast<int32_t>(column));
+    out.span_end_offset.push_back(static_cast<int32_t>(offset));
+    out.span_text.push_back(text);
+  }
+
+  int32_t Locate(CXSourceLocation loc, unsigned *line, unsigned *column,
+                 unsigned *offset) {
+    CXFile f = nullptr;
+    clang_getInstantiationLocation(loc, &f, line, column, offset);
+    if (!f) {
+      return -1;
+    }
+    auto it = file_ids_.find(f);
+    if (it != file_ids_.end()) {
+      return it->second;
+    }
+    auto id = static_cast<int32_t>(out_->files.size());
+    out_->files.push_back(FileName(f));
+    file_ids_.emplace(f, id);
+    return id;
+  }
+
+  std::shared_ptr<PackedDiagnostics> out_;
+  std::unordered_map<CXFile, int32_t> file_ids_;
+};
+
+std::shared_ptr<PackedDiagnostics> ExportDiagnostics(CXTranslationUnit tu) {
+  DiagnosticPacker packer;
+  CXDiagnosticSet set = clang_getDiagnosticSetFromTU(tu);
+  packer.AddSet(set);
+  clang_disposeDiagnosticSet(set);
+  return packer.Take();
+}
+
+/// Read a serialized diagnostics (.dia) file, as written by
+/// -serialize-diagnostics. Throws with libclang's message on failure.
+std::shared_ptr<PackedDiagnostics> LoadDiagnostics(const std::string &path) {
+  CXLoadDiag_Error error;
+  CXString message = {};
+  CXDiagnosticSet set = clang_loadDiagnostics(path.c_str(), &error, &message);
+  if (!set) {
+    const char *c_message = clang_getCString(message);
+    std::string what = path + ": " + (c_message ? c_message : "");
+    clang_disposeString(message);
+    throw std::runtime_error(what);
+  }
+  clang_disposeString(message);
+  DiagnosticPacker packer;
+  packer.AddSet(set);
+  clang_disposeDiagnosticSet(set);
+  return packer.Take();
+}
+
+/// Owning wrapper of a CXCursorSet. Cursors are compared by value like
+/// clang_equalCursors, the set does not keep their translation units alive.
+class CursorSet {
+public:
+  CursorSet() : set_(clang_createCXCursorSet()) {}
+  CursorSet(const CursorSet &) = delete;
+  CursorSet &operator=(const CursorSet &) = delete;
+  ~CursorSet() { clang_disposeCXCursorSet(set_); }
+
+  /// Returns true if `c` was not in the set yet.
+  bool Add(CXCursor c) {
+    bool inserted = clang_CXCursorSet_insert(set_, c) != 0;
+    size_ += inserted;
+    return inserted;
+  }
+  bool Contains(CXCursor c) const {
+    return clang_CXCursorSet_contains(set_, c) != 0;
+  }
+  size_t Size() const { return size_; }
+  void Clear() {
+    clang_disposeCXCursorSet(set_);
+    set_ = clang_createCXCursorSet();
+    size_ = 0;
+  }
+
+private:
+  CXCursorSet set_;
+  size_t size_ = 0;
+};
+
+/// Ranked completions as (typed_text, display, result_type, priority,
+/// availability, cursor_kind, index) tuples.
+pybind11::list CompletionItems(const std::vector<completion::Item> &items) {
+  pybind11::list out(items.size());
+  for (size_t i = 0; i < items.size(); ++i) {
+    auto &item = items[i];
+    out[i] = pybind11::make_tuple(item.typed_text, item.display,
+                                  item.result_type, item.priority,
+                                  item.availability, item.cursor_kind,
+                                  item.index);
+  }
+  return out;
+}
+
+/// Run `work` on `executor` without the GIL, then call `done(*convert(r))`
+/// on the worker thread with the GIL held. `owner` keeps the libclang object
+/// alive meanwhile. The Python objects are released under the GIL once the
+/// task ran, the task itself may be destroyed without it.
+template <class WorkT, class ConvertT>
+void SubmitAsync(SerialExecutor &executor, uintptr_t key,
+                 pybind11::object owner, pybind11::object done, WorkT work,
+                 ConvertT convert) {
+  auto held = std::make_shared<std::pair<pybind11::object, pybind11::object>>(
+      std::move(owner), std::move(done));
+  executor.Submit(key, [held, work = std::move(work),
+                        convert = std::move(convert)]() mutable {
+    auto result = work();
+    pybind11::gil_scoped_acquire gil;
+    try {
+      held->second(*convert(result));
+    } catch (pybind11::error_already_set &e) {
+      e.discard_as_unraisable("pylibclang async callback");
+    } catch (const std::exception &e) {
+      PyErr_SetString(PyExc_RuntimeError, e.what());
+      PyErr_WriteUnraisable(held->second.ptr());
+    }
+    held->first = pybind11::object();
+    held->second = pybind11::object();
+  });
+}
+
+/// A SerialExecutor whose tasks call back into Python. Its workers may be
+/// waiting for the GIL, so it is released while they are joined.
+struct AsyncPool {
+  explicit AsyncPool(size_t workers) : executor(workers) {}
+  ~AsyncPool() { Shutdown(); }
+
+  /// Returns the number of calls that never ran.
+  size_t Shutdown() {
+    std::vector<SerialExecutor::Task> dropped;
+    {
+      pybind11::gil_scoped_release _;
+      dropped = executor.Shutdown();
+    }
+    // Dropped tasks hold Python objects, they go away here with the GIL.
+    return dropped.size();
+  }
+
+  SerialExecutor executor;
+};
+
+std::vector<CXUnsavedFile> ToCXUnsavedFiles(
+    const std::vector<std::pair<std::string, std::string>> &files) {
+  std::vector<CXUnsavedFile> c_files;
+  for (auto &f : files) {
+    c_files.push_back({f.first.c_str(), f.second.data(),
+                       static_cast<unsigned long>(f.second.size())});
+  }
+  return c_files;
+}
+
+/// A Python buffer held with PyObject_GetBuffer, so libclang can read it in
+/// place: while pinned, a bytearray cannot be resized and an mmap cannot be
+/// closed. A str is pinned as its UTF-8 encoding. Create and destroy with the
+/// GIL held.
+class PinnedBuffer {
+public:
+  explicit PinnedBuffer(pybind11::handle obj) {
+    auto source = pybind11::reinterpret_borrow<pybind11::object>(obj);
+    if (PyUnicode_Check(obj.ptr())) {
+      source = pybind11::reinterpret_steal<pybind11::object>(
+          PyUnicode_AsUTF8String(obj.ptr()));
+      if (!source) {
+        throw pybind11::error_already_set();
+      }
+    }
+    // PyBUF_SIMPLE rejects non-contiguous buffers.
+    if (PyObject_GetBuffer(source.ptr(), &view_, PyBUF_SIMPLE) != 0) {
+      throw pybind11::error_already_set();
+    }
+  }
+  PinnedBuffer(const PinnedBuffer &) = delete;
+  PinnedBuffer &operator=(const PinnedBuffer &) = delete;
+  ~PinnedBuffer() { PyBuffer_Release(&view_); }
+
+  const char *data() const { return static_cast<const char *>(view_.buf); }
+  size_t size() const { return static_cast<size_t>(view_.len); }
+  pybind11::object object() const {
+    return pybind11::reinterpret_borrow<pybind11::object>(view_.obj);
+  }
+
+private:
+  Py_buffer view_;
+};
+
+/// Unsaved files that outlive a single libclang call. Contents are pinned
+/// Python buffers, so updating one file neither copies its contents nor
+/// touches the others, and the set can be passed to every parse, reparse and
+/// code completion of an editing session.
+///
+/// Calls take a Snapshot, which keeps the buffers it points to pinned even
+/// if the set changes while the GIL is released. Snapshots are dropped with
+/// the GIL held.
+class UnsavedFileSet {
+  struct Entry {
+    Entry(std::string name, pybind11::handle contents)
+        : name(std::move(name)), contents(contents) {}
+    std::string name;
+    PinnedBuffer contents;
+  };
+
+public:
+  struct Snapshot {
+    std::vector<std::shared_ptr<const Entry>> entries;
+    std::vector<CXUnsavedFile> files;
+  };
+
+  void Set(const std::string &name, pybind11::handle contents) {
+    entries_[name] = std::make_shared<const Entry>(name, contents);
+    snapshot_.reset();
+  }
+
+  bool Remove(const std::string &name) {
+    snapshot_.reset();
+    return entries_.erase(name) != 0;
+  }
+
+  void Clear() {
+    entries_.clear();
+    snapshot_.reset();
+  }
+
+  bool Contains(const std::string &name) const {
+    return entries_.count(name) != 0;
+  }
+  size_t Size() const { return entries_.size(); }
+
+  std::vector<std::string> Names() const {
+    std::vector<std::string> names;
+    for (auto &e : entries_) {
+      names.push_back(e.first);
+    }
+    return names;
+  }
+
+  /// The object pinned for `name`, the UTF-8 bytes if a str was set.
+  pybind11::object Get(const std::string &name) const {
+    auto it = entries_.find(name);
+    if (it == entries_.end()) {
+      throw pybind11::key_error(name);
+    }
+    return it->second->contents.object();
+  }
+
+  /// The CXUnsavedFile array of the current contents, rebuilt only after a
+  /// change.
+  std::shared_ptr<const Snapshot> Files() {
+    if (!snapshot_) {
+      auto snapshot = std::make_shared<Snapshot>();
+      for (auto &e : entries_) {
+        snapshot->entries.push_back(e.second);
+        snapshot->files.push_back(
+            {e.second->name.c_str(), e.second->contents.data(),
+             static_cast<unsigned long>(e.second->contents.size())});
+      }
+      snapshot_ = std::move(snapshot);
+    }
+    return snapshot_;
+  }
+
+private:
+  std::map<std::string, std::shared_ptr<const Entry>> entries_;
+  std::shared_ptr<const Snapshot> snapshot_;
+};
+
+/// Flag words of a column of kinds, see kind_tables.
+struct KindFlags {
+  std::vector<int32_t> flags;
+};
+
+/// Call `fn(i, kind)` for every element of a 1-d integer buffer. Any integer
+/// width and stride is accepted, so numpy arrays, memoryviews and the
+/// Int32Column views work alike. Other formats raise ValueError.
+template <class FnT>
+void ForEachKind(const pybind11::buffer_info &info, FnT &&fn) {
+  if (info.ndim != 1) {
+    throw pybind11::value_error("kinds must be a 1-dimensional buffer");
+  }
+  auto n = static_cast<size_t>(info.shape[0]);
+  auto stride = static_cast<ptrdiff_t>(info.strides[0]);
+  auto *data = static_cast<const char *>(info.ptr);
+  auto each = [&](auto zero) {
+    using KindT = decltype(zero);
+    for (size_t i = 0; i < n; ++i) {
+      KindT kind;
+      std::memcpy(&kind, data + stride * static_cast<ptrdiff_t>(i),
+                  sizeof(kind));
+      fn(i, static_cast<int64_t>(kind));
+    }
+  };
+  // A single struct module code, optionally after a byte order that
+  // matches the host's.
+  std::string_view format = info.format;
+  const uint16_t one = 1;
+  bool little_endian = *reinterpret_cast<const char *>(&one) == 1;
+  if (!format.empty() &&
+      (format[0] == '@' || format[0] == '=' ||
+       format[0] == (little_endian ? '<' : '>') ||
+       (!little_endian && format[0] == '!'))) {
+    format.remove_prefix(1);
+  }
+  char code = format.size() == 1 ? format[0] : '\0';
+  bool is_signed = code && std::strchr("bhilqn", code);
+  bool is_unsigned = code && std::strchr("BHILQN", code);
+  if (is_signed && info.itemsize == 1) {
+    each(int8_t());
+  } else if (is_signed && info.itemsize == 2) {
+    each(int16_t());
+  } else if (is_signed && info.itemsize == 4) {
+    each(int32_t());
+  } else if (is_signed && info.itemsize == 8) {
+    each(int64_t());
+  } else if (is_unsigned && info.itemsize == 1) {
+    each(uint8_t());
+  } else if (is_unsigned && info.itemsize == 2) {
+    each(uint16_t());
+  } else if (is_unsigned && info.itemsize == 4) {
+    each(uint32_t());
+  } else if (is_unsigned && info.itemsize == 8) {
+    each(uint64_t());
+  } else {
+    throw pybind11::value_error("kinds must be a buffer of native integers, "
+                                "got format '" + info.format + "'");
+  }
+}
+
+/// Bind the `<prefix>_flags`, `<prefix>_is`, `classify_<prefix>s`,
+/// `<prefix>_spelling` and `<prefix>_spellings` lookups of one kind enum.
+/// Spellings are fetched from libclang once for every kind in `kinds` and
+/// then handed out as shared str objects. The kinds come from the C enums,
+/// the generated Python enums only get their members once the module body
+/// has run.
+template <size_t N, class SpellFnT>
+void DefKindTable(pybind11::module_ &m, const std::string &prefix,
+                  const std::array<uint32_t, N> &table,
+                  const std::vector<int64_t> &kinds, SpellFnT &&spell) {
+  kind_tables::SpellingTable spellings;
+  spellings.Fill(kinds, spell);
+  pybind11::tuple strs(spellings.size());
+  for (size_t k = 0; k < spellings.size(); ++k) {
+    auto s = spellings.Get(static_cast<int64_t>(k));
+    strs[k] = pybind11::str(s.data(), s.size());
+  }
+  auto spelling = [strs](int64_t kind) -> pybind11::object {
+    if (kind < 0 || static_cast<uint64_t>(kind) >= strs.size()) {
+      return pybind11::str();
+    }
+    return strs[static_cast<size_t>(kind)];
+  };
+
+  m.def(
+      (prefix + "_flags").c_str(),
+      [&table](int64_t kind) { return kind_tables::Lookup(table, kind); },
+      pybind11::arg("kind"));
+  m.def(
+      (prefix + "_flags").c_str(),
+      [&table](const pybind11::buffer &kinds) {
+        auto info = kinds.request();
+        auto owner = std::make_shared<KindFlags>();
+        owner->flags.resize(static_cast<size_t>(info.size));
+        auto *out = owner->flags.data();
+        ForEachKind(info, [&](size_t i, int64_t kind) {
+          out[i] = static_cast<int32_t>(kind_tables::Lookup(table, kind));
+        });
+        return Int32Column<KindFlags>{owner, &owner->flags};
+      },
+      pybind11::arg("kinds"));
+  m.def(
+      (prefix + "_is").c_str(),
+      [&table](int64_t kind, uint32_t mask) {
+        return (kind_tables::Lookup(table, kind) & mask) != 0;
+      },
+      pybind11::arg("kind"), pybind11::arg("mask"));
+  m.def(
+      ("classify_" + prefix + "s").c_str(),
+      [&table](const pybind11::buffer &kinds, uint32_t mask) {
+        auto info = kinds.request();
+        pybind11::bytearray result(nullptr, static_cast<size_t>(info.size));
+        auto *out = PyByteArray_AS_STRING(result.ptr());
+        ForEachKind(info, [&](size_t i, int64_t kind) {
+          out[i] = (kind_tables::Lookup(table, kind) & mask) != 0;
+        });
+        return result;
+      },
+      pybind11::arg("kinds"), pybind11::arg("mask"),
+      "A bytearray holding 1 where a kind has any bit of `mask` set.");
+  m.def((prefix + "_spelling").c_str(), spelling, pybind11::arg("kind"));
+  m.def(
+      (prefix + "_spellings").c_str(),
+      [spelling](const pybind11::buffer &kinds) {
+        auto info = kinds.request();
+        pybind11::list result(static_cast<size_t>(info.size));
+        ForEachKind(info, [&](size_t i, int64_t kind) {
+          result[i] = spelling(kind);
+        });
+        return result;
+      },
+      pybind11::arg("kinds"));
+}
+
+/// Filters evaluated natively while visiting, so only matching cursors ever
+/// cross into Python. Empty `kinds`/`files`/`spelling_regex` match anything.
+struct CursorQuery {
+  std::vector<CXCursorKind> kinds;
+  bool main_file_only = false;
+  bool skip_system_headers = false;
+  std::vector<std::string> files; // exact names as reported by clang
+  std::string spelling_regex;     // searched with std::regex_search
+  int max_depth = -1;             // negative means unlimited
+  // Skip the whole subtree of a cursor that fails the location filters.
+  bool prune = true;
+  // Keep visiting the children of a matched cursor.
+  bool recurse_into_matches = true;
+};
+
+namespace query_detail {
+
+struct QueryState {
+  explicit QueryState(const CursorQuery &q) : query(q) {
+    for (auto k : q.kinds) {
+      if (static_cast<size_t>(k) >= kind_mask.size()) {
+        kind_mask.resize(static_cast<size_t>(k) + 1, false);
+      }
+      kind_mask[k] = true;
+    }
+    if (!q.spelling_regex.empty()) {
+      try {
+        spelling_re = std::regex(q.spelling_regex);
+      } catch (const std::regex_error &e) {
+        throw pybind11::value_error("invalid spelling_regex '" +
+                                    q.spelling_regex + "': " + e.what());
+      }
+    }
+  }
+
+  bool KindMatches(CXCursorKind k) const {
+    if (query.kinds.empty()) {
+      return true;
+    }
+    return static_cast<size_t>(k) < kind_mask.size() && kind_mask[k];
+  }
+
+  bool FileMatches(CXSourceLocation loc) {
+    if (query.files.empty()) {
+      return true;
+    }
+    CXFile f;
+    clang_getExpansionLocation(loc, &f, nullptr, nullptr, nullptr);
+    auto it = file_cache.find(f);
+    if (it != file_cache.end()) {
+      return it->second;
+    }
+    bool hit = false;
+    if (f) {
+      CXString name = clang_getFileName(f);
+      const char *c_name = clang_getCString(name);
+      for (auto &want : query.files) {
+        if (c_name && want == c_name) {
+          hit = true;
+          break;
+        }
+      }
+      clang_disposeString(name);
+    }
+    file_cache.emplace(f, hit);
+    return hit;
+  }
+
+  bool LocationMatches(CXCursor c) {
+    if (!query.main_file_only && !query.skip_system_headers &&
+        query.files.empty()) {
+      return true;
+    }
+    CXSourceLocation loc = clang_getCursorLocation(c);
+    if (query.skip_system_headers && clang_Location_isInSystemHeader(loc)) {
+      return false;
+    }
+    if (query.main_file_only && !clang_Location_isFromMainFile(loc)) {
+      return false;
+    }
+    return FileMatches(loc);
+  }
+
+  bool SpellingMatches(CXCursor c) const {
+    if (query.spelling_regex.empty()) {
+      return true;
+    }
+    CXString s = clang_getCursorSpelling(c);
+    const char *c_str = clang_getCString(s);
+    bool hit = std::regex_search(c_str ? c_str : "", spelling_re);
+    clang_disposeString(s);
+    return hit;
+  }
+
+  const CursorQuery &query;
+  std::vector<bool> kind_mask;
+  std::regex spelling_re;
+  std::unordered_map<CXFile, bool> file_cache;
+  std::vector<CXCursor> path; // root-to-node path of recursed cursors
+  std::vector<CXCursor> matches;
+};
+
+CXChildVisitResult Visit(CXCursor child, CXCursor parent, CXClientData data) {
+  auto *state = static_cast<QueryState *>(data);
+  while (state->path.size() > 1 &&
+         !clang_equalCursors(state->path.back(), parent)) {
+    state->path.pop_back();
+  }
+  int depth = static_cast<int>(state->path.size());
+  bool location_ok = state->LocationMatches(child);
+  if (!location_ok && state->query.prune) {
+    return CXChildVisit_Continue;
+  }
+  bool matched = location_ok && state->KindMatches(clang_getCursorKind(child)) &&
+                 state->SpellingMatches(child);
+  if (matched) {
+    state->matches.push_back(child);
+  }
+  if ((matched && !state->query.recurse_into_matches) ||
+      (state->query.max_depth >= 0 && depth >= state->query.max_depth)) {
+    return CXChildVisit_Continue;
+  }
+  state->path.push_back(child);
+  return CXChildVisit_Recurse;
+}
+
+} // namespace query_detail
+
+/// Collect the descendants of `root` accepted by `query`, in preorder.
+std::vector<CXCursor> QueryCursors(CXCursor root, const CursorQuery &query) {
+  query_detail::QueryState state(query);
+  if (query.max_depth == 0) {
+    return {};
+  }
+  state.path.push_back(root);
+  clang_visitChildren(root, &query_detail::Visit, &state);
+  return std::move(state.matches);
+}
+
 struct CustomCXUnsavedFile : public Entity_CXUnsavedFile {
   using Entity_CXUnsavedFile::Entity_CXUnsavedFile;
   void Update() override {
@@ -58,6 +1808,22 @@ struct CustomCXCodeCompleteResults : public Entity_CXCodeCompleteResults {
   }
 };
 
+struct CustomCXCursor : public Bind_CXCursor<SlimClass<CXCursor>> {
+  using Bind_CXCursor<SlimClass<CXCursor>>::Bind_CXCursor;
+  void Update() override {
+    Bind_CXCursor<SlimClass<CXCursor>>::Update();
+    DefTuSlot(handle);
+  }
+};
+
+struct CustomCXType : public Bind_CXType<SlimClass<CXType>> {
+  using Bind_CXType<SlimClass<CXType>>::Bind_CXType;
+  void Update() override {
+    Bind_CXType<SlimClass<CXType>>::Update();
+    DefTuSlot(handle);
+  }
+};
+
 PYBIND11_MODULE(_C, m) {
   pybind11_weaver::CustomBindingRegistry reg;
 
@@ -65,16 +1831,939 @@ PYBIND11_MODULE(_C, m) {
   reg.DisableBinding<Entity_clang_tokenize>();
   reg.DisableBinding<Entity_clang_parseTranslationUnit>();
   reg.DisableBinding<Entity_clang_reparseTranslationUnit>();
+  reg.DisableBinding<Entity_clang_codeCompleteAt>();
+  reg.DisableBinding<Entity_clang_disposeTranslationUnit>();
+  // Long running entry points, bound without holding the GIL so that Python
+  // threads working on different translation units can run in parallel.
+  reg.SetCustomBinding<Bind_clang_parseTranslationUnit2<GilFreeModule>>();
+  reg.SetCustomBinding<
+      Bind_clang_parseTranslationUnit2FullArgv<GilFreeModule>>();
+  reg.SetCustomBinding<Bind_clang_createTranslationUnit<GilFreeModule>>();
+  reg.SetCustomBinding<Bind_clang_createTranslationUnit2<GilFreeModule>>();
+  reg.SetCustomBinding<
+      Bind_clang_createTranslationUnitFromSourceFile<GilFreeModule>>();
+  reg.SetCustomBinding<Bind_clang_saveTranslationUnit<GilFreeModule>>();
+  reg.SetCustomBinding<Bind_clang_indexSourceFile<GilFreeModule>>();
+  reg.SetCustomBinding<Bind_clang_indexSourceFileFullArgv<GilFreeModule>>();
+  reg.SetCustomBinding<Bind_clang_indexTranslationUnit<GilFreeModule>>();
+  reg.SetCustomBinding<Bind_clang_sortCodeCompletionResults<GilFreeModule>>();
+  // String results are converted to Python str natively.
+  reg.SetCustomBinding<Bind_clang_CompileCommand_getArg<StrResultModule>>();
+  reg.SetCustomBinding<
+      Bind_clang_CompileCommand_getDirectory<StrResultModule>>();
+  reg.SetCustomBinding<
+      Bind_clang_CompileCommand_getFilename<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_formatDiagnostic<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getCompletionBriefComment<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getCompletionChunkText<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getCursorDisplayName<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getCursorSpelling<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getCursorUSR<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_Cursor_getMangling<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getDeclObjCTypeEncoding<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getDiagnosticCategoryText<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getDiagnosticFixIt<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getDiagnosticOption<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getDiagnosticSpelling<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getFileName<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getTokenSpelling<StrResultModule>>();
+  reg.SetCustomBinding<
+      Bind_clang_getTranslationUnitSpelling<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getTypedefName<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getTypeKindSpelling<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_getTypeSpelling<StrResultModule>>();
+  reg.SetCustomBinding<
+      Bind_clang_Cursor_getBriefCommentText<StrResultModule>>();
+  reg.SetCustomBinding<Bind_clang_Cursor_getRawCommentText<StrResultModule>>();
   reg.SetCustomBinding<CustomCXUnsavedFile>();
+  reg.SetCustomBinding<CustomCXCursor>();
+  reg.SetCustomBinding<CustomCXType>();
   reg.SetCustomBinding<CustomCXCompletionResult>();
   reg.SetCustomBinding<CustomCXCodeCompleteResults>();
   reg.DisableBinding<Entity_clang_CompilationDatabase_fromDirectory>();
+  reg.DisableBinding<Entity_clang_visitChildren>();
+  reg.DisableBinding<Entity_clang_Type_visitFields>();
+  reg.DisableBinding<Entity_clang_getInclusions>();
+  reg.DisableBinding<Entity_clang_findReferencesInFile>();
   auto update_guard = DeclFn(m, reg);
 
   pybind11::class_<TokenArray>(m, "TokenArray")
       .def("at", &TokenArray::at, pybind11::return_value_policy::reference)
       .def_readonly("n", &TokenArray::n);
 
+  m.def(
+      "clang_visitChildren",
+      [](CXCursor parent, ChildVisitorT visitor,
+         pybind11_weaver::WrappedPtrT<void *> client_data) {
+        return VisitChildren(parent, visitor, std::move(client_data));
+      },
+      pybind11::arg("parent"), pybind11::arg("visitor"),
+      pybind11::arg("client_data"));
+  m.def(
+      "clang_Type_visitFields",
+      [](CXType T, FieldVisitorT visitor,
+         pybind11_weaver::WrappedPtrT<void *> client_data) {
+        return VisitFields(T, visitor, std::move(client_data));
+      },
+      pybind11::arg("T"), pybind11::arg("visitor"),
+      pybind11::arg("client_data"));
+  m.def(
+      "clang_getInclusions",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu,
+         InclusionVisitorT visitor,
+         pybind11_weaver::WrappedPtrT<void *> client_data) {
+        VisitInclusions(tu->Cptr(), visitor, std::move(client_data));
+      },
+      pybind11::arg("tu"), pybind11::arg("visitor"),
+      pybind11::arg("client_data"));
+  m.def(
+      "clang_findReferencesInFile",
+      [](CXCursor cursor, pybind11_weaver::WrappedPtrT<void *> file,
+         ReferenceVisitorT visitor) {
+        return FindReferencesInFile(cursor, file->Cptr(), visitor);
+      },
+      pybind11::arg("cursor"), pybind11::arg("file"),
+      pybind11::arg("visitor"));
+
+  m.def(
+      "file_unique_id",
+      [](pybind11_weaver::WrappedPtrT<void *> file) {
+        return FileUniqueID(file->Cptr());
+      },
+      pybind11::arg("file"),
+      "clang_getFileUniqueID of `file` as (device, inode, mtime), or None.");
+  m.def(
+      "inclusion_graph",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu) {
+        pybind11::list out;
+        for (auto &inc : CollectInclusions(tu->Cptr())) {
+          out.append(pybind11::make_tuple(inc.file, inc.includer, inc.depth,
+                                          inc.unique_id));
+        }
+        return out;
+      },
+      pybind11::arg("tu"),
+      "Every inclusion of `tu` as (file, includer, depth, unique_id) "
+      "collected by one clang_getInclusions walk, without Python callbacks.");
+
+  pybind11::class_<CursorWalk>(m, "CursorWalk")
+      .def("__len__", &CursorWalk::size)
+      .def("at", &CursorWalk::at)
+      .def("parent", &CursorWalk::parent)
+      .def("depth", &CursorWalk::depth);
+
+  m.def(
+      "walk_subtree",
+      [](CXCursor cursor, int max_depth) {
+        return WalkSubtree(cursor, max_depth);
+      },
+      pybind11::arg("cursor"), pybind11::arg("max_depth") = -1,
+      "Collect the subtree of `cursor` in preorder with one "
+      "clang_visitChildren pass. Entry 0 is `cursor` itself.");
+
+  BindInt32Column<AstColumns>(m, "AstColumn");
+  pybind11::class_<AstColumns, std::shared_ptr<AstColumns>> ast_columns(
+      m, "AstColumns");
+  ast_columns.def("__len__", &AstColumns::size)
+      .def_readonly("files", &AstColumns::files)
+      .def_property_readonly(
+          "usrs", [](const AstColumns &self) { return self.usrs.strings; })
+      .def_property_readonly("spellings", [](const AstColumns &self) {
+        return self.spellings.strings;
+      });
+  DefInt32Column(ast_columns, "kind", &AstColumns::kind);
+  DefInt32Column(ast_columns, "parent", &AstColumns::parent);
+  DefInt32Column(ast_columns, "depth", &AstColumns::depth);
+  DefInt32Column(ast_columns, "file", &AstColumns::file);
+  DefInt32Column(ast_columns, "line", &AstColumns::line);
+  DefInt32Column(ast_columns, "column", &AstColumns::column);
+  DefInt32Column(ast_columns, "offset", &AstColumns::offset);
+  DefInt32Column(ast_columns, "end_offset", &AstColumns::end_offset);
+  DefInt32Column(ast_columns, "usr", &AstColumns::usr);
+  DefInt32Column(ast_columns, "spelling", &AstColumns::spelling);
+
+  m.def("export_ast_columns", &ExportAstColumns, pybind11::arg("cursor"),
+        pybind11::arg("with_usr") = true, pybind11::arg("with_spelling") = true,
+        "Export the subtree of `cursor` as int32 columns in preorder. Every "
+        "column supports the buffer protocol, e.g. numpy.asarray(cols.kind).");
+
+  BindInt32Column<PackedTokens>(m, "TokenColumn");
+  pybind11::class_<PackedTokens, std::shared_ptr<PackedTokens>> packed_tokens(
+      m, "PackedTokens");
+  packed_tokens.def("__len__", &PackedTokens::size)
+      .def("spelling", &PackedTokens::spelling)
+      .def_property_readonly("spellings",
+                             [](const PackedTokens &self) {
+                               std::vector<std::string_view> out;
+                               out.reserve(self.size());
+                               for (size_t i = 0; i < self.size(); ++i) {
+                                 out.push_back(self.spelling(i));
+                               }
+                               return out;
+                             })
+      .def_property_readonly("text", [](const PackedTokens &self) {
+        return pybind11::bytes(self.text);
+      });
+  DefInt32Column(packed_tokens, "kind", &PackedTokens::kind);
+  DefInt32Column(packed_tokens, "offset", &PackedTokens::offset);
+  DefInt32Column(packed_tokens, "end_offset", &PackedTokens::end_offset);
+  DefInt32Column(packed_tokens, "line", &PackedTokens::line);
+  DefInt32Column(packed_tokens, "column", &PackedTokens::column);
+  DefInt32Column(packed_tokens, "spelling_offset",
+                 &PackedTokens::spelling_offset);
+
+  m.def(
+      "tokenize_packed",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu,
+         CXSourceRange range) {
+        CXToken *tokens;
+        unsigned int num_tokens;
+        clang_tokenize(tu->Cptr(), range, &tokens, &num_tokens);
+        TokenArray array(tokens, num_tokens);
+        auto packed = PackTokens(tu->Cptr(), array);
+        if (num_tokens) {
+          clang_disposeTokens(tu->Cptr(), tokens, num_tokens);
+        }
+        return packed;
+      },
+      pybind11::arg("tu"), pybind11::arg("range"),
+      "Tokenize `range` and return every token's kind, offsets, line, column "
+      "and spelling as contiguous columns, no CXToken is kept alive.");
+
+  m.def(
+      "annotate_tokens",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu,
+         CXToken *tokens, unsigned int num_tokens) {
+        return AnnotateTokens(tu->Cptr(), tokens, num_tokens);
+      },
+      pybind11::arg("tu"), pybind11::arg("tokens"),
+      pybind11::arg("num_tokens"),
+      "Annotate `num_tokens` contiguous tokens starting at `tokens` with one "
+      "clang_annotateTokens call and return their cursors.");
+  m.def(
+      "annotate_tokens",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu,
+         TokenArray &tokens) {
+        return AnnotateTokens(tu->Cptr(), tokens.p, tokens.n);
+      },
+      pybind11::arg("tu"), pybind11::arg("tokens"));
+  m.def(
+      "annotate_tokens",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu,
+         CXSourceRange range) {
+        CXToken *tokens;
+        unsigned int num_tokens;
+        clang_tokenize(tu->Cptr(), range, &tokens, &num_tokens);
+        auto cursors = AnnotateTokens(tu->Cptr(), tokens, num_tokens);
+        if (num_tokens) {
+          clang_disposeTokens(tu->Cptr(), tokens, num_tokens);
+        }
+        return cursors;
+      },
+      pybind11::arg("tu"), pybind11::arg("range"));
+
+  BindInt32Column<AnnotatedTokens>(m, "AnnotationColumn");
+  pybind11::class_<AnnotatedTokens, std::shared_ptr<AnnotatedTokens>>
+      annotated_tokens(m, "AnnotatedTokens");
+  annotated_tokens.def("__len__", &AnnotatedTokens::size)
+      .def_readonly("tokens", &AnnotatedTokens::tokens)
+      .def_property_readonly("usrs", [](const AnnotatedTokens &self) {
+        return self.usrs.strings;
+      });
+  DefInt32Column(annotated_tokens, "cursor_kind",
+                 &AnnotatedTokens::cursor_kind);
+  DefInt32Column(annotated_tokens, "usr", &AnnotatedTokens::usr);
+
+  m.def(
+      "annotate_tokens_packed",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu,
+         CXSourceRange range, bool with_usr) {
+        return AnnotateRangePacked(tu->Cptr(), range, with_usr);
+      },
+      pybind11::arg("tu"), pybind11::arg("range"),
+      pybind11::arg("with_usr") = true,
+      "Tokenize and annotate `range` natively. Returns the packed tokens with "
+      "the annotating cursor kind and referenced USR id of every token.");
+
+  BindInt32Column<IndexRecords>(m, "IndexColumn");
+  pybind11::class_<IndexRecords, std::shared_ptr<IndexRecords>> index_records(
+      m, "IndexRecords");
+  index_records.def("__len__", &IndexRecords::size)
+      .def_readonly("files", &IndexRecords::files)
+      .def_property_readonly(
+          "usrs", [](const IndexRecords &self) { return self.usrs.strings; })
+      .def_property_readonly("names", [](const IndexRecords &self) {
+        return self.names.strings;
+      });
+  DefInt32Column(index_records, "is_reference", &IndexRecords::is_reference);
+  DefInt32Column(index_records, "entity_kind", &IndexRecords::entity_kind);
+  DefInt32Column(index_records, "usr", &IndexRecords::usr);
+  DefInt32Column(index_records, "name", &IndexRecords::name);
+  DefInt32Column(index_records, "file", &IndexRecords::file);
+  DefInt32Column(index_records, "line", &IndexRecords::line);
+  DefInt32Column(index_records, "column", &IndexRecords::column);
+  DefInt32Column(index_records, "offset", &IndexRecords::offset);
+  DefInt32Column(index_records, "container", &IndexRecords::container);
+  DefInt32Column(index_records, "role", &IndexRecords::role);
+  DefInt32Column(index_records, "flags", &IndexRecords::flags);
+  m.attr("INDEX_RECORD_DEFINITION") = int(kIndexRecordDefinition);
+  m.attr("INDEX_RECORD_REDECLARATION") = int(kIndexRecordRedeclaration);
+  m.attr("INDEX_RECORD_IMPLICIT") = int(kIndexRecordImplicit);
+  m.attr("INDEX_RECORD_CONTAINER") = int(kIndexRecordContainer);
+  m.attr("INDEX_RECORD_SKIPPED") = int(kIndexRecordSkipped);
+
+  BindInt32Column<PackedDiagnostics>(m, "DiagnosticColumn");
+  pybind11::class_<PackedDiagnostics, std::shared_ptr<PackedDiagnostics>>
+      packed_diagnostics(m, "PackedDiagnostics");
+  packed_diagnostics.def("__len__", &PackedDiagnostics::size)
+      .def_property_readonly("num_spans", &PackedDiagnostics::num_spans)
+      .def_readonly("files", &PackedDiagnostics::files)
+      .def_property_readonly("strings", [](const PackedDiagnostics &self) {
+        return self.strings.strings;
+      });
+  DefInt32Column(packed_diagnostics, "severity", &PackedDiagnostics::severity);
+  DefInt32Column(packed_diagnostics, "category", &PackedDiagnostics::category);
+  DefInt32Column(packed_diagnostics, "category_name",
+                 &PackedDiagnostics::category_name);
+  DefInt32Column(packed_diagnostics, "option", &PackedDiagnostics::option);
+  DefInt32Column(packed_diagnostics, "disable_option",
+                 &PackedDiagnostics::disable_option);
+  DefInt32Column(packed_diagnostics, "message", &PackedDiagnostics::message);
+  DefInt32Column(packed_diagnostics, "parent", &PackedDiagnostics::parent);
+  DefInt32Column(packed_diagnostics, "file", &PackedDiagnostics::file);
+  DefInt32Column(packed_diagnostics, "line", &PackedDiagnostics::line);
+  DefInt32Column(packed_diagnostics, "column", &PackedDiagnostics::column);
+  DefInt32Column(packed_diagnostics, "offset", &PackedDiagnostics::offset);
+  DefInt32Column(packed_diagnostics, "span_diagnostic",
+                 &PackedDiagnostics::span_diagnostic);
+  DefInt32Column(packed_diagnostics, "span_is_fixit",
+                 &PackedDiagnostics::span_is_fixit);
+  DefInt32Column(packed_diagnostics, "span_file",
+                 &PackedDiagnostics::span_file);
+  DefInt32Column(packed_diagnostics, "span_line",
+                 &PackedDiagnostics::span_line);
+  DefInt32Column(packed_diagnostics, "span_column",
+                 &PackedDiagnostics::span_column);
+  DefInt32Column(packed_diagnostics, "span_offset",
+                 &PackedDiagnostics::span_offset);
+  DefInt32Column(packed_diagnostics, "span_end_line",
+                 &PackedDiagnostics::span_end_line);
+  DefInt32Column(packed_diagnostics, "span_end_column",
+                 &PackedDiagnostics::span_end_column);
+  DefInt32Column(packed_diagnostics, "span_end_offset",
+                 &PackedDiagnostics::span_end_offset);
+  DefInt32Column(packed_diagnostics, "span_text",
+                 &PackedDiagnostics::span_text);
+
+  m.def(
+      "export_diagnostics",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu) {
+        pybind11::gil_scoped_release _;
+        return ExportDiagnostics(tu->Cptr());
+      },
+      pybind11::arg("tu"),
+      "Export every diagnostic of `tu`, with its child notes, source ranges "
+      "and fix-its, as PackedDiagnostics in one call.");
+  m.def("load_diagnostics", &LoadDiagnostics, pybind11::arg("path"),
+        pybind11::call_guard<pybind11::gil_scoped_release>(),
+        "Read a serialized diagnostics (.dia) file into PackedDiagnostics. "
+        "Raises RuntimeError when libclang cannot load it.");
+
+  m.def(
+      "index_source_file",
+      [](pybind11_weaver::WrappedPtrT<void *> index, std::string filename,
+         std::vector<std::string> args, bool full_argv,
+         std::vector<CXUnsavedFile> unsaved_files, unsigned index_options,
+         unsigned tu_options, bool with_references) {
+        pybind11::gil_scoped_release _;
+        std::vector<const char *> c_args;
+        for (auto &a : args) {
+          c_args.push_back(a.c_str());
+        }
+        IndexCollector collector(with_references);
+        IndexerCallbacks cb = IndexCollector::Callbacks();
+        CXIndexAction action = clang_IndexAction_create(index->Cptr());
+        int err;
+        if (full_argv) {
+          err = clang_indexSourceFileFullArgv(
+              action, &collector, &cb, sizeof(cb), index_options, nullptr,
+              c_args.data(), static_cast<int>(c_args.size()),
+              unsaved_files.data(), unsaved_files.size(), nullptr, tu_options);
+        } else {
+          err = clang_indexSourceFile(
+              action, &collector, &cb, sizeof(cb), index_options,
+              filename.empty() ? nullptr : filename.c_str(), c_args.data(),
+              static_cast<int>(c_args.size()), unsaved_files.data(),
+              unsaved_files.size(), nullptr, tu_options);
+        }
+        clang_IndexAction_dispose(action);
+        return std::make_tuple(collector.records(), err);
+      },
+      pybind11::arg("index"), pybind11::arg("filename"), pybind11::arg("args"),
+      pybind11::arg("full_argv"), pybind11::arg("unsaved_files"),
+      pybind11::arg("index_options"), pybind11::arg("tu_options"),
+      pybind11::arg("with_references") = true,
+      "Parse and index a source file with clang_indexSourceFile, collecting "
+      "declarations and references natively. Returns (IndexRecords, error).");
+  pybind11::class_<IndexSession>(m, "IndexSession")
+      .def(pybind11::init([](pybind11_weaver::WrappedPtrT<void *> index,
+                             unsigned index_options, bool with_references) {
+             return std::make_unique<IndexSession>(index->Cptr(), index_options,
+                                                   with_references);
+           }),
+           pybind11::arg("index"), pybind11::arg("index_options"),
+           pybind11::arg("with_references") = true)
+      .def("index_source_file", &IndexSession::IndexFile,
+           pybind11::arg("filename"), pybind11::arg("args"),
+           pybind11::arg("full_argv"), pybind11::arg("unsaved_files"),
+           pybind11::arg("tu_options"),
+           pybind11::call_guard<pybind11::gil_scoped_release>(),
+           "Index one file within the session. Returns (IndexRecords, error).")
+      .def_property_readonly("files", &IndexSession::Files)
+      .def_property_readonly("errors", &IndexSession::Errors)
+      .def_property_readonly("seen_files", &IndexSession::SeenFiles)
+      .def_property_readonly("records", &IndexSession::Records)
+      .def_property_readonly("duplicates", &IndexSession::Duplicates)
+      .def_property_readonly("skipped_files", &IndexSession::SkippedFiles)
+      .def_property_readonly("seconds", &IndexSession::Seconds);
+
+  m.def(
+      "index_translation_unit",
+      [](pybind11_weaver::WrappedPtrT<void *> index,
+         pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu,
+         unsigned index_options, bool with_references) {
+        pybind11::gil_scoped_release _;
+        IndexCollector collector(with_references);
+        IndexerCallbacks cb = IndexCollector::Callbacks();
+        CXIndexAction action = clang_IndexAction_create(index->Cptr());
+        int err = clang_indexTranslationUnit(action, &collector, &cb,
+                                             sizeof(cb), index_options,
+                                             tu->Cptr());
+        clang_IndexAction_dispose(action);
+        return std::make_tuple(collector.records(), err);
+      },
+      pybind11::arg("index"), pybind11::arg("tu"),
+      pybind11::arg("index_options"), pybind11::arg("with_references") = true,
+      "Index an already parsed translation unit with "
+      "clang_indexTranslationUnit. Returns (IndexRecords, error).");
+
+  pybind11::class_<symbol_index::Builder>(m, "SymbolIndexBuilder")
+      .def(pybind11::init())
+      .def(
+          "load",
+          [](symbol_index::Builder &self, const std::string &path) {
+            symbol_index::Reader reader(path);
+            self.Load(reader);
+          },
+          pybind11::arg("path"),
+          "Add every unit of an existing index file.")
+      .def(
+          "add_records",
+          [](symbol_index::Builder &self, const std::string &unit,
+             const IndexRecords &records, uint32_t role_mask) {
+            AddIndexRecords(self, unit, records, role_mask);
+          },
+          pybind11::arg("unit"), pybind11::arg("records"),
+          pybind11::arg("role_mask") = 0,
+          "Replace the postings of `unit` with the entries of IndexRecords "
+          "that have a USR and a role in role_mask (any role when 0).")
+      .def(
+          "add_columns",
+          [](symbol_index::Builder &self, const std::string &unit,
+             const AstColumns &cols) { AddAstColumns(self, unit, cols); },
+          pybind11::arg("unit"), pybind11::arg("columns"),
+          "Replace the postings of `unit` with the cursors of AstColumns that "
+          "have a USR, recorded as declarations.")
+      .def("remove_unit", &symbol_index::Builder::RemoveUnit,
+           pybind11::arg("unit"))
+      .def_property_readonly("units", &symbol_index::Builder::UnitNames)
+      .def("__len__", &symbol_index::Builder::NumPostings)
+      .def("write", &symbol_index::Builder::Write, pybind11::arg("path"),
+           pybind11::call_guard<pybind11::gil_scoped_release>(),
+           "Write the index, atomically replacing `path`.");
+
+  pybind11::class_<symbol_index::Reader>(m, "SymbolIndex")
+      .def(pybind11::init<const std::string &>(), pybind11::arg("path"))
+      .def("close", &symbol_index::Reader::Close)
+      .def("__len__",
+           [](const symbol_index::Reader &self) {
+             return CheckedReader(self).NumSymbols();
+           })
+      .def_property_readonly("num_postings",
+                             [](const symbol_index::Reader &self) {
+                               return CheckedReader(self).NumPostings();
+                             })
+      .def_property_readonly("files",
+                             [](const symbol_index::Reader &self) {
+                               return TableStrings(
+                                   CheckedReader(self).Files());
+                             })
+      .def_property_readonly("units",
+                             [](const symbol_index::Reader &self) {
+                               return TableStrings(
+                                   CheckedReader(self).Units());
+                             })
+      .def("__contains__",
+           [](const symbol_index::Reader &self, std::string_view usr) {
+             return CheckedReader(self).Find(usr) >= 0;
+           })
+      .def("usr",
+           [](const symbol_index::Reader &self, uint32_t i) {
+             return CheckedReader(self).Symbols().at(i);
+           })
+      .def(
+          "usrs_with_prefix",
+          [](const symbol_index::Reader &self, std::string_view prefix,
+             size_t limit) {
+            auto &r = CheckedReader(self);
+            std::vector<std::string_view> out;
+            for (uint32_t i = r.LowerBound(prefix);
+                 i < r.NumSymbols() && out.size() < limit; ++i) {
+              auto usr = r.Symbols().at(i);
+              if (usr.substr(0, prefix.size()) != prefix) {
+                break;
+              }
+              out.push_back(usr);
+            }
+            return out;
+          },
+          pybind11::arg("prefix"), pybind11::arg("limit") = SIZE_MAX)
+      .def(
+          "lookup",
+          [](const symbol_index::Reader &self, std::string_view usr,
+             uint32_t role_mask) {
+            auto &r = CheckedReader(self);
+            pybind11::list out;
+            int64_t symbol = r.Find(usr);
+            if (symbol < 0) {
+              return out;
+            }
+            for (auto &p : r.Lookup(static_cast<uint32_t>(symbol), role_mask)) {
+              out.append(pybind11::make_tuple(r.Files().at(p.file), p.line,
+                                              p.column, p.offset, p.role));
+            }
+            return out;
+          },
+          pybind11::arg("usr"), pybind11::arg("role_mask") = 0,
+          "Locations of `usr` as (file, line, column, offset, role) with any "
+          "role bit of role_mask (all when 0), found by binary search.");
+
+  m.def(
+      "dump_ast",
+      [](CXCursor cursor, int fd, int format, bool with_type, bool with_usr,
+         bool main_file_only, int max_depth, const std::string &tu_name,
+         const std::vector<std::string> &tu_args) {
+        if (format != static_cast<int>(ast_dump::Format::kNdjson) &&
+            format != static_cast<int>(ast_dump::Format::kMsgpack)) {
+          throw std::invalid_argument("dump_ast: unknown format");
+        }
+        ast_dump::Options options;
+        options.format = static_cast<ast_dump::Format>(format);
+        options.with_type = with_type;
+        options.with_usr = with_usr;
+        options.main_file_only = main_file_only;
+        options.max_depth = max_depth;
+        ast_dump::Dumper dumper(fd, options);
+        if (!tu_name.empty()) {
+          dumper.WriteTranslationUnit(tu_name, tu_args);
+        }
+        return dumper.Dump(cursor);
+      },
+      pybind11::arg("cursor"), pybind11::arg("fd"), pybind11::arg("format") = 0,
+      pybind11::arg("with_type") = true, pybind11::arg("with_usr") = true,
+      pybind11::arg("main_file_only") = false, pybind11::arg("max_depth") = -1,
+      pybind11::arg("tu_name") = "",
+      pybind11::arg("tu_args") = std::vector<std::string>(),
+      pybind11::call_guard<pybind11::gil_scoped_release>(),
+      "Stream the subtree of `cursor` to file descriptor `fd` while visiting, "
+      "as NDJSON (format 0) or MessagePack (format 1). A {tu, args} record is "
+      "written first when tu_name is set. Returns the number of nodes.");
+  m.attr("DUMP_NDJSON") = static_cast<int>(ast_dump::Format::kNdjson);
+  m.attr("DUMP_MSGPACK") = static_cast<int>(ast_dump::Format::kMsgpack);
+
+  // clang_equalCursors/clang_hashCursor as the Python protocol, so cursors
+  // work as dict keys without calling back into Python.
+  auto cursor_cls = pybind11::reinterpret_borrow<
+      pybind11::class_<CXCursor, TuHolder<CXCursor>>>(m.attr("CXCursor"));
+  cursor_cls
+      .def(
+          "__eq__",
+          [](const CXCursor &a, const CXCursor &b) {
+            return clang_equalCursors(a, b) != 0;
+          },
+          pybind11::is_operator())
+      .def(
+          "__ne__",
+          [](const CXCursor &a, const CXCursor &b) {
+            return clang_equalCursors(a, b) == 0;
+          },
+          pybind11::is_operator())
+      .def("__hash__",
+           [](const CXCursor &c) { return clang_hashCursor(c); });
+
+  pybind11::class_<CursorSet>(m, "CursorSet")
+      .def(pybind11::init())
+      .def("add", &CursorSet::Add, pybind11::arg("cursor"),
+           "Insert `cursor`, returns True if it was not in the set yet.")
+      .def(
+          "update",
+          [](CursorSet &self, const std::vector<CXCursor> &cursors) {
+            size_t inserted = 0;
+            for (auto &c : cursors) {
+              inserted += self.Add(c);
+            }
+            return inserted;
+          },
+          pybind11::arg("cursors"),
+          "Insert every cursor, returns how many were new.")
+      .def("__contains__", &CursorSet::Contains)
+      .def("__len__", &CursorSet::Size)
+      .def("clear", &CursorSet::Clear);
+
+  BindInt32Column<KindFlags>(m, "KindFlagColumn");
+  DefKindTable(m, "cursor_kind", kind_tables::kCursorKindTable,
+               kind_tables::CursorKinds(), [](int kind) {
+                 return clang_getCursorKindSpelling(
+                     static_cast<CXCursorKind>(kind));
+               });
+  DefKindTable(m, "type_kind", kind_tables::kTypeKindTable,
+               kind_tables::TypeKinds(), [](int kind) {
+                 return clang_getTypeKindSpelling(
+                     static_cast<CXTypeKind>(kind));
+               });
+  m.attr("CURSOR_KIND_DECLARATION") = int(kind_tables::kCursorDeclaration);
+  m.attr("CURSOR_KIND_REFERENCE") = int(kind_tables::kCursorReference);
+  m.attr("CURSOR_KIND_EXPRESSION") = int(kind_tables::kCursorExpression);
+  m.attr("CURSOR_KIND_STATEMENT") = int(kind_tables::kCursorStatement);
+  m.attr("CURSOR_KIND_ATTRIBUTE") = int(kind_tables::kCursorAttribute);
+  m.attr("CURSOR_KIND_INVALID") = int(kind_tables::kCursorInvalid);
+  m.attr("CURSOR_KIND_TRANSLATION_UNIT") =
+      int(kind_tables::kCursorTranslationUnit);
+  m.attr("CURSOR_KIND_PREPROCESSING") = int(kind_tables::kCursorPreprocessing);
+  m.attr("CURSOR_KIND_UNEXPOSED") = int(kind_tables::kCursorUnexposed);
+  m.attr("TYPE_KIND_BUILTIN") = int(kind_tables::kTypeBuiltin);
+  m.attr("TYPE_KIND_INTEGER") = int(kind_tables::kTypeInteger);
+  m.attr("TYPE_KIND_SIGNED_INTEGER") = int(kind_tables::kTypeSignedInteger);
+  m.attr("TYPE_KIND_UNSIGNED_INTEGER") = int(kind_tables::kTypeUnsignedInteger);
+  m.attr("TYPE_KIND_FLOATING") = int(kind_tables::kTypeFloating);
+  m.attr("TYPE_KIND_POINTER") = int(kind_tables::kTypePointer);
+  m.attr("TYPE_KIND_REFERENCE") = int(kind_tables::kTypeReference);
+  m.attr("TYPE_KIND_ARRAY") = int(kind_tables::kTypeArray);
+  m.attr("TYPE_KIND_VECTOR") = int(kind_tables::kTypeVector);
+  m.attr("TYPE_KIND_FUNCTION") = int(kind_tables::kTypeFunction);
+  m.attr("TYPE_KIND_SUGAR") = int(kind_tables::kTypeSugar);
+  m.attr("TYPE_KIND_OPENCL") = int(kind_tables::kTypeOpenCL);
+
+  pybind11::class_<CursorQuery>(m, "CursorQuery")
+      .def(pybind11::init())
+      .def_readwrite("kinds", &CursorQuery::kinds)
+      .def_readwrite("main_file_only", &CursorQuery::main_file_only)
+      .def_readwrite("skip_system_headers", &CursorQuery::skip_system_headers)
+      .def_readwrite("files", &CursorQuery::files)
+      .def_readwrite("spelling_regex", &CursorQuery::spelling_regex)
+      .def_readwrite("max_depth", &CursorQuery::max_depth)
+      .def_readwrite("prune", &CursorQuery::prune)
+      .def_readwrite("recurse_into_matches",
+                     &CursorQuery::recurse_into_matches);
+
+  m.def("query_cursors", &QueryCursors, pybind11::arg("cursor"),
+        pybind11::arg("query"),
+        "Visit the subtree of `cursor` and return the descendants accepted "
+        "by `query`. Filtering happens in C++, only matches are returned.");
+
+  m.def(
+      "set_string_interning",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu,
+         bool enabled, size_t capacity) {
+        auto &tables = cxstring::InternTables();
+        if (enabled) {
+          tables[tu->Cptr()].capacity = capacity;
+        } else {
+          tables.erase(tu->Cptr());
+        }
+      },
+      pybind11::arg("tu"), pybind11::arg("enabled"),
+      pybind11::arg("capacity") = 65536,
+      "Enable or disable (and drop) the string intern table of `tu`. While "
+      "enabled, equal strings returned for cursors, tokens and files of `tu` "
+      "share one Python object, up to `capacity` distinct strings. The table "
+      "is dropped by clang_disposeTranslationUnit.");
+  m.def(
+      "clang_disposeTranslationUnit",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu) {
+        // A later TU may be allocated at the same address.
+        cxstring::InternTables().erase(tu->Cptr());
+        clang_disposeTranslationUnit(tu->Cptr());
+      },
+      "Destroy the specified CXTranslationUnit object and its string intern "
+      "table.");
+  m.def(
+      "file_name",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu,
+         pybind11_weaver::WrappedPtrT<void *> file) {
+        // A CXFile does not know its TU, the caller names it.
+        return cxstring::ToPyStr(clang_getFileName(file->Cptr()), tu->Cptr());
+      },
+      pybind11::arg("tu"), pybind11::arg("file"),
+      "clang_getFileName, interned in the table of `tu`, the translation "
+      "unit `file` belongs to.");
+  m.def("string_interning_size",
+        [](pybind11_weaver::WrappedPtrT<CXTranslationUnitImpl *> tu) {
+          auto &tables = cxstring::InternTables();
+          auto it = tables.find(tu->Cptr());
+          return it == tables.end() ? size_t(0) : it->second.strings.size();
+        });
+
+  pybind11::class_<LocationDecoder>(m, "LocationDecoder")
+      .def(pybind11::init<size_t>(), pybind11::arg("capacity") = 65536)
+      .def("decode",
+           [](LocationDecoder &self, CXSourceLocation location) {
+             auto d = self.Decode(location);
+             return std::make_tuple(d.file, d.line, d.column, d.offset);
+           })
+      .def(
+          "decode_locations",
+          [](LocationDecoder &self,
+             const std::vector<CXSourceLocation> &locations) {
+            std::vector<std::tuple<int32_t, unsigned, unsigned, unsigned>> out;
+            out.reserve(locations.size());
+            for (auto &d : self.DecodeMany(locations)) {
+              out.emplace_back(d.file, d.line, d.column, d.offset);
+            }
+            return out;
+          },
+          "Decode a list of CXSourceLocation into (file id, line, column, "
+          "offset) tuples, file id is -1 for locations without a file.")
+      .def("file",
+           [](LocationDecoder &self, int32_t id) {
+             return pybind11_weaver::WrapP(self.File(id));
+           })
+      .def_property_readonly("num_files", &LocationDecoder::NumFiles)
+      .def_property_readonly("capacity", &LocationDecoder::Capacity)
+      .def_property_readonly("hits", &LocationDecoder::Hits)
+      .def_property_readonly("misses", &LocationDecoder::Misses)
+      .def("__len__", &LocationDecoder::Size)
+      .def("clear", &LocationDecoder::Clear);
+
+  pybind11::class_<ParsePool>(m, "ParsePool")
+      .def(pybind11::init(
+               [](const std::vector<pybind11_weaver::WrappedPtrT<void *>>
+                      &indexes) {
+                 std::vector<CXIndex> c_indexes;
+                 for (auto &idx : indexes) {
+                   c_indexes.push_back(idx->Cptr());
+                 }
+                 return std::make_unique<ParsePool>(std::move(c_indexes));
+               }),
+           "Start one worker thread per CXIndex. Each index is only used by "
+           "its own worker and must outlive the pool.")
+      .def(
+          "submit",
+          [](ParsePool &self, int64_t id, std::string filename,
+             std::vector<std::string> args, bool full_argv,
+             unsigned int options) {
+            self.Submit({id, std::move(filename), std::move(args), full_argv,
+                         options});
+          },
+          pybind11::arg("id"), pybind11::arg("filename"), pybind11::arg("args"),
+          pybind11::arg("full_argv"), pybind11::arg("options"))
+      .def(
+          "next",
+          [](ParsePool &self) -> pybind11::object {
+            std::optional<ParsePool::Result> r;
+            {
+              pybind11::gil_scoped_release _;
+              r = self.Next();
+            }
+            if (!r) {
+              return pybind11::none();
+            }
+            return pybind11::make_tuple(r->id, r->worker,
+                                        pybind11_weaver::WrapP(r->tu),
+                                        static_cast<int>(r->error));
+          },
+          "Block until a job finishes and return (id, worker, tu, error), or "
+          "None when nothing is pending.")
+      .def("pending", &ParsePool::Pending)
+      .def("shutdown", &ParsePool::Shutdown,
+           pybind11::call_guard<pybind11::gil_scoped_release>());
+
+  using UnsavedFiles = std::vector<std::pair<std::string, std::string>>;
+  pybind11::class_<completion::Service>(m, "CompletionService")
+      .def(pybind11::init([](std::string filename,
+                             std::vector<std::string> args,
+                             UnsavedFiles unsaved_files, unsigned options) {
+             pybind11::gil_scoped_release _;
+             return std::make_unique<completion::Service>(
+                 std::move(filename), std::move(args),
+                 std::move(unsaved_files), options);
+           }),
+           pybind11::arg("filename"), pybind11::arg("args"),
+           pybind11::arg("unsaved_files"), pybind11::arg("options"),
+           "Parse `filename` with cached completion results and a "
+           "precompiled preamble on a new service thread.")
+      .def(
+          "submit",
+          [](completion::Service &self, std::string filename, unsigned line,
+             unsigned column, UnsavedFiles unsaved_files, unsigned options,
+             std::string prefix, size_t limit) {
+            completion::Service::Request r;
+            r.filename = std::move(filename);
+            r.line = line;
+            r.column = column;
+            r.unsaved_files = std::move(unsaved_files);
+            r.options = options;
+            r.prefix = std::move(prefix);
+            r.limit = limit;
+            return self.Submit(std::move(r));
+          },
+          pybind11::arg("filename"), pybind11::arg("line"),
+          pybind11::arg("column"), pybind11::arg("unsaved_files"),
+          pybind11::arg("options"), pybind11::arg("prefix"),
+          pybind11::arg("limit"))
+      .def(
+          "wait",
+          [](completion::Service &self, int64_t id,
+             double timeout) -> pybind11::object {
+            std::optional<completion::Service::Result> r;
+            {
+              pybind11::gil_scoped_release _;
+              r = self.Wait(id, timeout);
+            }
+            if (!r) {
+              return pybind11::none();
+            }
+            return pybind11::make_tuple(static_cast<int>(r->status),
+                                        CompletionItems(r->items),
+                                        r->seconds);
+          },
+          pybind11::arg("id"), pybind11::arg("timeout") = -1.0,
+          "Return (status, items, seconds), or None on timeout.")
+      .def("cancel", &completion::Service::Cancel, pybind11::arg("id"))
+      .def("stats",
+           [](completion::Service &self) {
+             auto st = self.GetStats();
+             pybind11::dict d;
+             d["submitted"] = st.submitted;
+             d["completed"] = st.completed;
+             d["failed"] = st.failed;
+             d["coalesced"] = st.coalesced;
+             d["dropped"] = st.dropped;
+             d["cancelled"] = st.cancelled;
+             auto histogram = [](const completion::LatencyHistogram &h) {
+               pybind11::dict out;
+               out["count"] = h.count();
+               out["mean_ms"] = h.mean() / 1e3;
+               out["p50_ms"] = static_cast<double>(h.Percentile(0.5)) / 1e3;
+               out["p90_ms"] = static_cast<double>(h.Percentile(0.9)) / 1e3;
+               out["p99_ms"] = static_cast<double>(h.Percentile(0.99)) / 1e3;
+               out["max_ms"] = static_cast<double>(h.max()) / 1e3;
+               return out;
+             };
+             d["latency"] = histogram(st.latency);
+             d["complete"] = histogram(st.complete);
+             return d;
+           })
+      .def("close", &completion::Service::Close,
+           pybind11::call_guard<pybind11::gil_scoped_release>());
+  m.attr("COMPLETION_DONE") =
+      static_cast<int>(completion::Service::Status::kDone);
+  m.attr("COMPLETION_FAILED") =
+      static_cast<int>(completion::Service::Status::kFailed);
+  m.attr("COMPLETION_DROPPED") =
+      static_cast<int>(completion::Service::Status::kDropped);
+
+  pybind11::class_<AsyncPool>(m, "AsyncPool")
+      .def(pybind11::init<size_t>(), pybind11::arg("workers"),
+           "Native threads running libclang calls for asyncio. Calls on the "
+           "same translation unit, or parses with the same index, run one at "
+           "a time in submission order.")
+      .def(
+          "parse",
+          [](AsyncPool &self, pybind11::object index,
+             std::optional<std::string> filename, std::vector<std::string> args,
+             UnsavedFiles unsaved_files, unsigned options,
+             pybind11::object done) {
+            CXIndex c_index =
+                index.cast<pybind11_weaver::WrappedPtrT<void *>>()->Cptr();
+            auto work = [=] {
+              std::vector<const char *> c_args;
+              for (auto &a : args) {
+                c_args.push_back(a.c_str());
+              }
+              auto c_unsaved = ToCXUnsavedFiles(unsaved_files);
+              CXTranslationUnit tu = nullptr;
+              CXErrorCode err = clang_parseTranslationUnit2(
+                  c_index, filename ? filename->c_str() : nullptr,
+                  c_args.data(), static_cast<int>(c_args.size()),
+                  c_unsaved.data(), static_cast<unsigned>(c_unsaved.size()),
+                  options, &tu);
+              return std::make_pair(tu, err);
+            };
+            auto convert = [](std::pair<CXTranslationUnit, CXErrorCode> r) {
+              return pybind11::make_tuple(pybind11_weaver::WrapP(r.first),
+                                          static_cast<int>(r.second));
+            };
+            SubmitAsync(self.executor, reinterpret_cast<uintptr_t>(c_index),
+                        std::move(index), std::move(done), std::move(work),
+                        convert);
+          },
+          pybind11::arg("index"), pybind11::arg("filename"),
+          pybind11::arg("args"), pybind11::arg("unsaved_files"),
+          pybind11::arg("options"), pybind11::arg("done"),
+          "Parse, then call done(tu, error) on the worker thread.")
+      .def(
+          "reparse",
+          [](AsyncPool &self, pybind11::object tu,
+             UnsavedFiles unsaved_files, unsigned options,
+             pybind11::object done) {
+            CXTranslationUnit c_tu =
+                tu.cast<pybind11_weaver::WrappedPtrT<CXTranslationUnit>>()
+                    ->Cptr();
+            auto work = [=] {
+              auto c_unsaved = ToCXUnsavedFiles(unsaved_files);
+              return clang_reparseTranslationUnit(
+                  c_tu, static_cast<unsigned>(c_unsaved.size()),
+                  c_unsaved.data(), options);
+            };
+            auto convert = [](int err) { return pybind11::make_tuple(err); };
+            SubmitAsync(self.executor, reinterpret_cast<uintptr_t>(c_tu),
+                        std::move(tu), std::move(done), std::move(work),
+                        convert);
+          },
+          pybind11::arg("tu"), pybind11::arg("unsaved_files"),
+          pybind11::arg("options"), pybind11::arg("done"),
+          "Reparse, then call done(error) on the worker thread.")
+      .def(
+          "code_complete",
+          [](AsyncPool &self, pybind11::object tu, std::string filename,
+             unsigned line, unsigned column, UnsavedFiles unsaved_files,
+             unsigned options, pybind11::object done) {
+            CXTranslationUnit c_tu =
+                tu.cast<pybind11_weaver::WrappedPtrT<CXTranslationUnit>>()
+                    ->Cptr();
+            auto work = [=] {
+              auto c_unsaved = ToCXUnsavedFiles(unsaved_files);
+              return clang_codeCompleteAt(
+                  c_tu, filename.c_str(), line, column, c_unsaved.data(),
+                  static_cast<unsigned>(c_unsaved.size()), options);
+            };
+            auto convert = [](CXCodeCompleteResults *r) {
+              return pybind11::make_tuple(pybind11::cast(
+                  r, pybind11::return_value_policy::reference));
+            };
+            SubmitAsync(self.executor, reinterpret_cast<uintptr_t>(c_tu),
+                        std::move(tu), std::move(done), std::move(work),
+                        convert);
+          },
+          pybind11::arg("tu"), pybind11::arg("filename"), pybind11::arg("line"),
+          pybind11::arg("column"), pybind11::arg("unsaved_files"),
+          pybind11::arg("options"), pybind11::arg("done"),
+          "Code complete, then call done(results) on the worker thread.")
+      .def("pending",
+           [](AsyncPool &self) { return self.executor.Pending(); })
+      .def("shutdown", &AsyncPool::Shutdown);
+
   pybind11::class_<StringHolder>(m, "StringHolder")
       .def_readwrite("content", &StringHolder::content)
       .def(pybind11::init())
@@ -96,25 +2785,151 @@ PYBIND11_MODULE(_C, m) {
           return TokenArray(tokens, num_tokens);
         });
 
+  pybind11::class_<UnsavedFileSet>(m, "UnsavedFileSet")
+      .def(pybind11::init())
+      .def("set", &UnsavedFileSet::Set, pybind11::arg("name"),
+           pybind11::arg("contents"),
+           "Map `name` to `contents`, any object with the buffer protocol "
+           "(bytes, bytearray, memoryview, mmap) or a str. Buffers are "
+           "pinned and read in place, not copied.")
+      .def("remove", &UnsavedFileSet::Remove, pybind11::arg("name"),
+           "Drop `name`, returns True if it was in the set.")
+      .def("clear", &UnsavedFileSet::Clear)
+      .def("names", &UnsavedFileSet::Names)
+      .def("get", &UnsavedFileSet::Get, pybind11::arg("name"),
+           "The object pinned for `name`, the UTF-8 bytes if a str was set.")
+      .def("__contains__", &UnsavedFileSet::Contains)
+      .def("__len__", &UnsavedFileSet::Size);
+
+  m.def(
+      "clang_parseTranslationUnit",
+      [](pybind11_weaver::WrappedPtrT<void *> CIdx, const char *source_filename,
+         const std::vector<std::string> &command_line_args,
+         std::vector<CXUnsavedFile> unsaved_files, unsigned int options) {
+        std::vector<const char *> c_args;
+        for (auto &v : command_line_args) {
+          c_args.push_back(v.c_str());
+        }
+        return pybind11_weaver::WrapP(clang_parseTranslationUnit(
+            CIdx->Cptr(), source_filename, c_args.data(), c_args.size(),
+            unsaved_files.data(), unsaved_files.size(), options));
+      },
+      pybind11::call_guard<pybind11::gil_scoped_release>());
   m.def("clang_parseTranslationUnit",
         [](pybind11_weaver::WrappedPtrT<void *> CIdx,
            const char *source_filename,
            const std::vector<std::string> &command_line_args,
-           std::vector<CXUnsavedFile> unsaved_files, unsigned int options) {
+           UnsavedFileSet &unsaved_files, unsigned int options) {
           std::vector<const char *> c_args;
           for (auto &v : command_line_args) {
             c_args.push_back(v.c_str());
           }
+          auto unsaved = unsaved_files.Files();
+          pybind11::gil_scoped_release _;
           return pybind11_weaver::WrapP(clang_parseTranslationUnit(
               CIdx->Cptr(), source_filename, c_args.data(), c_args.size(),
-              unsaved_files.data(), unsaved_files.size(), options));
+              const_cast<CXUnsavedFile *>(unsaved->files.data()),
+              unsaved->files.size(), options));
         });
+  m.def(
+      "clang_reparseTranslationUnit",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnit> tu,
+         std::vector<CXUnsavedFile> unsaved_files, unsigned int options) {
+        return clang_reparseTranslationUnit(tu->Cptr(), unsaved_files.size(),
+                                            unsaved_files.data(), options);
+      },
+      pybind11::call_guard<pybind11::gil_scoped_release>());
   m.def("clang_reparseTranslationUnit",
         [](pybind11_weaver::WrappedPtrT<CXTranslationUnit> tu,
-           std::vector<CXUnsavedFile> unsaved_files, unsigned int options) {
-          return clang_reparseTranslationUnit(tu->Cptr(), unsaved_files.size(),
-                                              unsaved_files.data(), options);
+           UnsavedFileSet &unsaved_files, unsigned int options) {
+          auto unsaved = unsaved_files.Files();
+          pybind11::gil_scoped_release _;
+          return clang_reparseTranslationUnit(
+              tu->Cptr(), unsaved->files.size(),
+              const_cast<CXUnsavedFile *>(unsaved->files.data()), options);
         });
+  m.def(
+      "clang_codeCompleteAt",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnit> tu,
+         const char *complete_filename, unsigned int complete_line,
+         unsigned int complete_column, std::vector<CXUnsavedFile> unsaved_files,
+         unsigned int options) {
+        return clang_codeCompleteAt(tu->Cptr(), complete_filename,
+                                    complete_line, complete_column,
+                                    unsaved_files.data(), unsaved_files.size(),
+                                    options);
+      },
+      pybind11::return_value_policy::reference,
+      pybind11::call_guard<pybind11::gil_scoped_release>());
+  m.def(
+      "clang_codeCompleteAt",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnit> tu,
+         const char *complete_filename, unsigned int complete_line,
+         unsigned int complete_column, UnsavedFileSet &unsaved_files,
+         unsigned int options) {
+        auto unsaved = unsaved_files.Files();
+        pybind11::gil_scoped_release _;
+        return clang_codeCompleteAt(
+            tu->Cptr(), complete_filename, complete_line, complete_column,
+            const_cast<CXUnsavedFile *>(unsaved->files.data()),
+            unsaved->files.size(), options);
+      },
+      pybind11::return_value_policy::reference);
+  m.def(
+      "rank_code_completions",
+      [](CXCodeCompleteResults &results, const std::string &prefix,
+         size_t limit) {
+        std::vector<completion::Item> items;
+        {
+          pybind11::gil_scoped_release _;
+          items = completion::Rank(&results, prefix, limit);
+        }
+        return CompletionItems(items);
+      },
+      pybind11::arg("results"), pybind11::arg("prefix") = "",
+      pybind11::arg("limit") = 0,
+      "Sort `results` in place, fuzzy match their typed text against "
+      "`prefix` and return the best `limit` (0 for all) as (typed_text, "
+      "display, result_type, priority, availability, cursor_kind, index) "
+      "tuples.");
+  m.def(
+      "clang_suspendTranslationUnit",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnit> tu) {
+        return clang_suspendTranslationUnit(tu->Cptr());
+      },
+      pybind11::call_guard<pybind11::gil_scoped_release>());
+
+  m.def(
+      "create_translation_unit",
+      [](pybind11_weaver::WrappedPtrT<void *> index, const char *ast_filename) {
+        CXTranslationUnit tu = nullptr;
+        CXErrorCode err;
+        {
+          pybind11::gil_scoped_release _;
+          err = clang_createTranslationUnit2(index->Cptr(), ast_filename, &tu);
+        }
+        return std::make_tuple(
+            pybind11_weaver::WrapP<CXTranslationUnitImpl *>(tu), err);
+      },
+      pybind11::arg("index"), pybind11::arg("ast_filename"),
+      "Load an AST file with clang_createTranslationUnit2, returns "
+      "(tu or None, CXErrorCode).");
+
+  m.def(
+      "tu_resource_usage",
+      [](pybind11_weaver::WrappedPtrT<CXTranslationUnit> tu) {
+        CXTUResourceUsage usage = clang_getCXTUResourceUsage(tu->Cptr());
+        pybind11::dict out;
+        for (unsigned i = 0; i < usage.numEntries; ++i) {
+          const char *name =
+              clang_getTUResourceUsageName(usage.entries[i].kind);
+          out[pybind11::str(name ? name : "")] = usage.entries[i].amount;
+        }
+        clang_disposeCXTUResourceUsage(usage);
+        return out;
+      },
+      pybind11::arg("tu"),
+      "Return clang_getCXTUResourceUsage of `tu` as a {name: bytes} dict.");
 
   m.def("clang_CompilationDatabase_fromDirectory", [=](const char *BuildDir) {
     CXCompilationDatabase_Error ErrorCode;
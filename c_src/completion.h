@@ -0,0 +1,188 @@
+//
+// License: MIT
+//
+
+#ifndef PYLIBCLANG_COMPLETION_H
+#define PYLIBCLANG_COMPLETION_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "clang-c/Index.h"
+
+namespace completion {
+
+/// Fuzzy match `pattern` against `candidate` as a case-insensitive
+/// subsequence. Returns 0 when it does not match, otherwise a score that
+/// favours exact case, consecutive runs, word starts (after `_` or a
+/// lower-to-upper case change) and plain prefix matches. An empty pattern
+/// matches everything with score 1.
+inline int FuzzyScore(std::string_view pattern, std::string_view candidate) {
+  if (pattern.empty()) {
+    return 1;
+  }
+  if (pattern.size() > candidate.size()) {
+    return 0;
+  }
+  auto lower = [](char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  };
+  auto is_word_start = [&](size_t i) {
+    if (i == 0) {
+      return true;
+    }
+    auto prev = static_cast<unsigned char>(candidate[i - 1]);
+    auto cur = static_cast<unsigned char>(candidate[i]);
+    return !std::isalnum(prev) || (std::islower(prev) && std::isupper(cur));
+  };
+
+  int score = 1;
+  size_t p = 0;
+  size_t last = std::string_view::npos;
+  for (size_t i = 0; i < candidate.size() && p < pattern.size(); ++i) {
+    if (lower(candidate[i]) != lower(pattern[p])) {
+      continue;
+    }
+    score += 1;
+    if (candidate[i] == pattern[p]) {
+      score += 2;
+    }
+    if (last != std::string_view::npos && last + 1 == i) {
+      score += 4;
+    }
+    if (is_word_start(i)) {
+      score += 6;
+    }
+    last = i;
+    ++p;
+  }
+  if (p < pattern.size()) {
+    return 0;
+  }
+  if (candidate.substr(0, pattern.size()) == pattern) {
+    score += candidate.size() == pattern.size() ? 30 : 20;
+  }
+  return score;
+}
+
+/// One ranked completion. `index` is the position in
+/// CXCodeCompleteResults::Results after sorting.
+struct Item {
+  std::string typed_text;
+  std::string display;
+  std::string result_type;
+  unsigned priority = 0;
+  CXAvailabilityKind availability = CXAvailability_Available;
+  CXCursorKind cursor_kind = CXCursor_NotImplemented;
+  unsigned index = 0;
+  int score = 0;
+};
+
+template <class FnT>
+void WithChunkText(CXCompletionString s, unsigned i, FnT &&fn) {
+  CXString text = clang_getCompletionChunkText(s, i);
+  const char *c_str = clang_getCString(text);
+  fn(std::string_view(c_str ? c_str : ""));
+  clang_disposeString(text);
+}
+
+inline std::string TypedText(CXCompletionString s) {
+  std::string typed;
+  unsigned n = clang_getNumCompletionChunks(s);
+  for (unsigned i = 0; i < n; ++i) {
+    if (clang_getCompletionChunkKind(s, i) == CXCompletionChunk_TypedText) {
+      WithChunkText(s, i, [&](std::string_view t) { typed = t; });
+      break;
+    }
+  }
+  return typed;
+}
+
+/// Fill the display and result type of `item` from its completion string.
+/// The display is every chunk but the result type and optional chunks, in
+/// order, e.g. "push_back(const T &value)".
+inline void Describe(CXCompletionString s, Item &item) {
+  unsigned n = clang_getNumCompletionChunks(s);
+  for (unsigned i = 0; i < n; ++i) {
+    switch (clang_getCompletionChunkKind(s, i)) {
+    case CXCompletionChunk_ResultType:
+      WithChunkText(s, i, [&](std::string_view t) { item.result_type = t; });
+      break;
+    case CXCompletionChunk_Optional:
+      break;
+    case CXCompletionChunk_VerticalSpace:
+      item.display.push_back(' ');
+      break;
+    default:
+      WithChunkText(s, i, [&](std::string_view t) { item.display += t; });
+    }
+  }
+}
+
+/// Rank `results` against the typed `prefix` and return the best `limit`
+/// items (all when `limit` is 0), ordered by fuzzy score, then priority.
+///
+/// Results are sorted in place with clang_sortCodeCompletionResults first,
+/// so ties keep libclang's alphabetical order. Only the typed text is read
+/// while scoring, the rest of the completion string is decoded for the
+/// survivors only.
+inline std::vector<Item> Rank(CXCodeCompleteResults *results,
+                              std::string_view prefix, size_t limit) {
+  std::vector<Item> items;
+  if (!results) {
+    return items;
+  }
+  clang_sortCodeCompletionResults(results->Results, results->NumResults);
+
+  struct Candidate {
+    unsigned index;
+    int score;
+    unsigned priority;
+  };
+  std::vector<Candidate> candidates;
+  std::vector<std::string> typed(results->NumResults);
+  for (unsigned i = 0; i < results->NumResults; ++i) {
+    CXCompletionString s = results->Results[i].CompletionString;
+    typed[i] = TypedText(s);
+    int score = FuzzyScore(prefix, typed[i]);
+    if (score > 0) {
+      candidates.push_back({i, score, clang_getCompletionPriority(s)});
+    }
+  }
+  auto better = [](const Candidate &a, const Candidate &b) {
+    if (a.score != b.score) {
+      return a.score > b.score;
+    }
+    if (a.priority != b.priority) {
+      return a.priority < b.priority;
+    }
+    return a.index < b.index;
+  };
+  size_t keep = limit ? std::min(limit, candidates.size()) : candidates.size();
+  std::partial_sort(candidates.begin(), candidates.begin() + keep,
+                    candidates.end(), better);
+  candidates.resize(keep);
+
+  items.reserve(keep);
+  for (auto &c : candidates) {
+    const CXCompletionResult &r = results->Results[c.index];
+    Item item;
+    item.typed_text = std::move(typed[c.index]);
+    item.priority = c.priority;
+    item.availability = clang_getCompletionAvailability(r.CompletionString);
+    item.cursor_kind = r.CursorKind;
+    item.index = c.index;
+    item.score = c.score;
+    Describe(r.CompletionString, item);
+    items.push_back(std::move(item));
+  }
+  return items;
+}
+
+} // namespace completion
+
+#endif // PYLIBCLANG_COMPLETION_H
@@ -0,0 +1,400 @@
+//
+// License: MIT
+//
+
+#ifndef PYLIBCLANG_COMPLETION_SERVICE_H
+#define PYLIBCLANG_COMPLETION_SERVICE_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "clang-c/Index.h"
+#include "completion.h"
+
+namespace completion {
+
+/// Log-linear histogram of microsecond latencies. Every power of two is split
+/// into four buckets, so percentiles are within 25% of the recorded value.
+class LatencyHistogram {
+public:
+  void Record(uint64_t us) {
+    ++buckets_[Bucket(us)];
+    ++count_;
+    sum_ += us;
+    max_ = std::max(max_, us);
+  }
+
+  /// Upper bound of the bucket holding the `q` quantile, 0 when empty.
+  uint64_t Percentile(double q) const {
+    if (!count_) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(count_) + 0.5);
+    rank = std::min(std::max<uint64_t>(rank, 1), count_);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::min(UpperBound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  uint64_t count() const { return count_; }
+  uint64_t max() const { return max_; }
+  double mean() const {
+    return count_ ? static_cast<double>(sum_) / static_cast<double>(count_)
+                  : 0.0;
+  }
+
+private:
+  static constexpr unsigned kSubBits = 2;
+  static constexpr uint64_t kLinear = 1u << (kSubBits + 1);
+
+  static size_t Bucket(uint64_t v) {
+    if (v < kLinear) {
+      return static_cast<size_t>(v);
+    }
+    unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(v));
+    unsigned shift = msb - kSubBits;
+    uint64_t sub = (v >> shift) & ((1u << kSubBits) - 1);
+    return kLinear + (msb - kSubBits - 1) * (1u << kSubBits) + sub;
+  }
+
+  static uint64_t UpperBound(size_t bucket) {
+    if (bucket < kLinear) {
+      return bucket;
+    }
+    size_t i = bucket - kLinear;
+    unsigned shift = static_cast<unsigned>(i >> kSubBits) + 1;
+    uint64_t sub = i & ((1u << kSubBits) - 1);
+    return (((1u << kSubBits) + sub + 1) << shift) - 1;
+  }
+
+  std::array<uint64_t, kLinear + (64 - kSubBits - 1) * (1u << kSubBits)>
+      buckets_{};
+  uint64_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t max_ = 0;
+};
+
+/// Runs clang_codeCompleteAt for one translation unit on a dedicated thread.
+///
+/// The thread parses the translation unit with cached completion results and
+/// a precompiled preamble, then serves requests. Requests are coalesced per
+/// file: submitting a position for a file replaces the request still queued
+/// for it, and a request that finishes after a newer one for the same file
+/// was submitted is dropped. Only the latest result per file is kept until
+/// it is collected.
+class Service {
+public:
+  enum class Status { kDone = 0, kFailed = 1, kDropped = 2 };
+
+  struct Request {
+    std::string filename;
+    unsigned line = 0;
+    unsigned column = 0;
+    std::vector<std::pair<std::string, std::string>> unsaved_files;
+    unsigned options = 0;
+    std::string prefix;
+    size_t limit = 0;
+  };
+
+  struct Result {
+    Status status = Status::kDropped;
+    std::vector<Item> items;
+    double seconds = 0;
+  };
+
+  struct Stats {
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t coalesced = 0; // replaced while queued
+    uint64_t dropped = 0;   // finished after being superseded or cancelled
+    uint64_t cancelled = 0;
+    LatencyHistogram latency;  // submit to result
+    LatencyHistogram complete; // clang_codeCompleteAt and ranking only
+  };
+
+  /// Parse `filename` on the service thread and wait for it. Throws with
+  /// the CXErrorCode if parsing fails.
+  Service(std::string filename, std::vector<std::string> args,
+          std::vector<std::pair<std::string, std::string>> unsaved_files,
+          unsigned options)
+      : index_(clang_createIndex(0, 0)) {
+    options |= CXTranslationUnit_CacheCompletionResults |
+               CXTranslationUnit_PrecompiledPreamble;
+    CXErrorCode err = CXError_Success;
+    bool parsed = false;
+    thread_ = std::thread([&, this] {
+      std::vector<const char *> c_args;
+      for (auto &a : args) {
+        c_args.push_back(a.c_str());
+      }
+      auto c_unsaved = ToCXUnsavedFiles(unsaved_files);
+      CXErrorCode e = clang_parseTranslationUnit2(
+          index_, filename.c_str(), c_args.data(),
+          static_cast<int>(c_args.size()), c_unsaved.data(),
+          static_cast<unsigned>(c_unsaved.size()), options, &tu_);
+      {
+        std::lock_guard<std::mutex> _(mu_);
+        err = e;
+        parsed = true;
+      }
+      cv_.notify_all();
+      if (e == CXError_Success) {
+        WorkerLoop();
+      }
+    });
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [&] { return parsed; });
+    if (err != CXError_Success) {
+      lock.unlock();
+      thread_.join();
+      clang_disposeIndex(index_);
+      throw std::runtime_error(
+          "Error parsing translation unit (CXErrorCode " +
+          std::to_string(static_cast<int>(err)) + ").");
+    }
+  }
+
+  Service(const Service &) = delete;
+  Service &operator=(const Service &) = delete;
+
+  ~Service() {
+    Close();
+    clang_disposeIndex(index_);
+  }
+
+  /// Queue a request and return its id. A request still queued for the same
+  /// file is dropped in its favour.
+  int64_t Submit(Request request) {
+    std::lock_guard<std::mutex> _(mu_);
+    if (closed_) {
+      throw std::runtime_error("completion service is closed");
+    }
+    int64_t id = next_id_++;
+    ++stats_.submitted;
+    auto [it, inserted] = queued_.try_emplace(request.filename);
+    auto &queued = it->second;
+    if (inserted) {
+      order_.push_back(request.filename);
+    } else if (queued.id) {
+      files_.erase(queued.id);
+      ++stats_.coalesced;
+    }
+    latest_[request.filename] = id;
+    files_[id] = request.filename;
+    queued.id = id;
+    queued.submitted = Clock::now();
+    queued.request = std::move(request);
+    cv_.notify_all();
+    return id;
+  }
+
+  /// Wait up to `timeout` seconds (forever if negative) for request `id`.
+  /// Returns nothing on timeout. Requests that were coalesced, cancelled,
+  /// superseded or already collected report kDropped.
+  std::optional<Result> Wait(int64_t id, double timeout) {
+    std::unique_lock<std::mutex> lock(mu_);
+    if (id <= 0 || id >= next_id_) {
+      throw std::out_of_range("unknown completion request");
+    }
+    auto ready = [&] { return !files_.count(id) || results_.count(id); };
+    if (timeout < 0) {
+      cv_.wait(lock, ready);
+    } else if (!cv_.wait_for(lock, std::chrono::duration<double>(timeout),
+                             ready)) {
+      return std::nullopt;
+    }
+    auto it = results_.find(id);
+    if (it == results_.end()) {
+      return Result{};
+    }
+    Result r = std::move(it->second);
+    results_.erase(it);
+    ForgetLocked(id);
+    return r;
+  }
+
+  /// Drop request `id` if it is queued or running. Returns false if it was
+  /// already finished.
+  bool Cancel(int64_t id) {
+    std::lock_guard<std::mutex> _(mu_);
+    auto it = files_.find(id);
+    if (it == files_.end() || results_.count(id)) {
+      return false;
+    }
+    auto queued = queued_.find(it->second);
+    if (queued != queued_.end() && queued->second.id == id) {
+      queued->second.id = 0;
+    } else {
+      cancel_running_ = true;
+    }
+    ++stats_.cancelled;
+    files_.erase(it);
+    cv_.notify_all();
+    return true;
+  }
+
+  Stats GetStats() {
+    std::lock_guard<std::mutex> _(mu_);
+    return stats_;
+  }
+
+  /// Stop the thread after the running request and dispose the translation
+  /// unit. Pending waits return kDropped.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> _(mu_);
+      if (closed_) {
+        return;
+      }
+      closed_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    std::lock_guard<std::mutex> _(mu_);
+    if (tu_) {
+      clang_disposeTranslationUnit(tu_);
+      tu_ = nullptr;
+    }
+    queued_.clear();
+    order_.clear();
+    files_.clear();
+    results_.clear();
+    cv_.notify_all();
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Queued {
+    int64_t id = 0; // 0 once cancelled
+    Clock::time_point submitted;
+    Request request;
+  };
+
+  static std::vector<CXUnsavedFile> ToCXUnsavedFiles(
+      const std::vector<std::pair<std::string, std::string>> &files) {
+    std::vector<CXUnsavedFile> c_files;
+    for (auto &f : files) {
+      c_files.push_back({f.first.c_str(), f.second.data(),
+                         static_cast<unsigned long>(f.second.size())});
+    }
+    return c_files;
+  }
+
+  static uint64_t Micros(Clock::duration d) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+  }
+
+  void ForgetLocked(int64_t id) {
+    auto it = files_.find(id);
+    if (it == files_.end()) {
+      return;
+    }
+    auto stored = stored_.find(it->second);
+    if (stored != stored_.end() && stored->second == id) {
+      stored_.erase(stored);
+    }
+    files_.erase(it);
+  }
+
+  void WorkerLoop() {
+    while (true) {
+      Queued job;
+      {
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_.wait(lock, [this] { return closed_ || !order_.empty(); });
+        if (closed_) {
+          return;
+        }
+        std::string filename = std::move(order_.front());
+        order_.pop_front();
+        auto it = queued_.find(filename);
+        job = std::move(it->second);
+        queued_.erase(it);
+        if (!job.id) {
+          continue;
+        }
+        cancel_running_ = false;
+      }
+
+      auto &req = job.request;
+      auto started = Clock::now();
+      auto c_unsaved = ToCXUnsavedFiles(req.unsaved_files);
+      CXCodeCompleteResults *results = clang_codeCompleteAt(
+          tu_, req.filename.c_str(), req.line, req.column, c_unsaved.data(),
+          static_cast<unsigned>(c_unsaved.size()), req.options);
+      Result r;
+      r.status = results ? Status::kDone : Status::kFailed;
+      r.items = Rank(results, req.prefix, req.limit);
+      if (results) {
+        clang_disposeCodeCompleteResults(results);
+      }
+      auto finished = Clock::now();
+      r.seconds = std::chrono::duration<double>(finished - job.submitted)
+                      .count();
+
+      std::lock_guard<std::mutex> _(mu_);
+      stats_.complete.Record(Micros(finished - started));
+      if (cancel_running_ || latest_[req.filename] != job.id) {
+        ++stats_.dropped;
+        files_.erase(job.id);
+      } else {
+        ++(results ? stats_.completed : stats_.failed);
+        stats_.latency.Record(Micros(finished - job.submitted));
+        // An uncollected older result of this file is superseded now.
+        auto stored = stored_.find(req.filename);
+        if (stored != stored_.end()) {
+          results_.erase(stored->second);
+          files_.erase(stored->second);
+        }
+        stored_[req.filename] = job.id;
+        results_[job.id] = std::move(r);
+      }
+      cv_.notify_all();
+    }
+  }
+
+  CXIndex index_;
+  CXTranslationUnit tu_ = nullptr;
+  std::thread thread_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  // Files with a queued request in FIFO order, and that request.
+  std::deque<std::string> order_;
+  std::unordered_map<std::string, Queued> queued_;
+  // Latest request id submitted per file.
+  std::unordered_map<std::string, int64_t> latest_;
+  // File of every queued, running or uncollected request.
+  std::unordered_map<int64_t, std::string> files_;
+  // Uncollected results, at most one per file.
+  std::unordered_map<int64_t, Result> results_;
+  std::unordered_map<std::string, int64_t> stored_;
+  Stats stats_;
+  int64_t next_id_ = 1;
+  bool cancel_running_ = false;
+  bool closed_ = false;
+};
+
+} // namespace completion
+
+#endif // PYLIBCLANG_COMPLETION_SERVICE_H
@@ -0,0 +1,258 @@
+//
+// License: MIT
+//
+
+#ifndef PYLIBCLANG_KIND_TABLES_H
+#define PYLIBCLANG_KIND_TABLES_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "clang-c/Index.h"
+
+namespace kind_tables {
+
+/// Category bits of a CXCursorKind. The ranges are the ones libclang's own
+/// clang_isDeclaration(), clang_isExpression() etc. test.
+enum CursorKindFlag : uint32_t {
+  kCursorDeclaration = 1u << 0,
+  kCursorReference = 1u << 1,
+  kCursorExpression = 1u << 2,
+  kCursorStatement = 1u << 3,
+  kCursorAttribute = 1u << 4,
+  kCursorInvalid = 1u << 5,
+  kCursorTranslationUnit = 1u << 6,
+  kCursorPreprocessing = 1u << 7,
+  kCursorUnexposed = 1u << 8,
+};
+
+/// Category bits of a CXTypeKind.
+enum TypeKindFlag : uint32_t {
+  kTypeBuiltin = 1u << 0,
+  kTypeInteger = 1u << 1,
+  kTypeSignedInteger = 1u << 2,
+  kTypeUnsignedInteger = 1u << 3,
+  kTypeFloating = 1u << 4,
+  kTypePointer = 1u << 5,
+  kTypeReference = 1u << 6,
+  kTypeArray = 1u << 7,
+  kTypeVector = 1u << 8,
+  kTypeFunction = 1u << 9,
+  kTypeSugar = 1u << 10,
+  kTypeOpenCL = 1u << 11,
+};
+
+// Both enums are well below these bounds, kinds outside map to no flags.
+constexpr size_t kNumCursorKinds = 1024;
+constexpr size_t kNumTypeKinds = 256;
+
+constexpr bool InRange(int k, int first, int last) {
+  return k >= first && k <= last;
+}
+
+constexpr uint32_t CursorKindFlagsOf(int k) {
+  uint32_t flags = 0;
+  if (InRange(k, CXCursor_FirstDecl, CXCursor_LastDecl) ||
+      InRange(k, CXCursor_FirstExtraDecl, CXCursor_LastExtraDecl)) {
+    flags |= kCursorDeclaration;
+  }
+  if (InRange(k, CXCursor_FirstRef, CXCursor_LastRef)) {
+    flags |= kCursorReference;
+  }
+  if (InRange(k, CXCursor_FirstExpr, CXCursor_LastExpr)) {
+    flags |= kCursorExpression;
+  }
+  if (InRange(k, CXCursor_FirstStmt, CXCursor_LastStmt)) {
+    flags |= kCursorStatement;
+  }
+  if (InRange(k, CXCursor_FirstAttr, CXCursor_LastAttr)) {
+    flags |= kCursorAttribute;
+  }
+  if (InRange(k, CXCursor_FirstInvalid, CXCursor_LastInvalid)) {
+    flags |= kCursorInvalid;
+  }
+  if (k == CXCursor_TranslationUnit) {
+    flags |= kCursorTranslationUnit;
+  }
+  if (InRange(k, CXCursor_FirstPreprocessing, CXCursor_LastPreprocessing)) {
+    flags |= kCursorPreprocessing;
+  }
+  if (k == CXCursor_UnexposedDecl || k == CXCursor_UnexposedExpr ||
+      k == CXCursor_UnexposedStmt || k == CXCursor_UnexposedAttr) {
+    flags |= kCursorUnexposed;
+  }
+  return flags;
+}
+
+constexpr uint32_t TypeKindFlagsOf(int k) {
+  uint32_t flags = 0;
+  if (InRange(k, CXType_FirstBuiltin, CXType_LastBuiltin)) {
+    flags |= kTypeBuiltin;
+  }
+  if (InRange(k, CXType_Char_U, CXType_UInt128)) {
+    flags |= kTypeInteger | kTypeUnsignedInteger;
+  }
+  if (InRange(k, CXType_Char_S, CXType_Int128)) {
+    flags |= kTypeInteger | kTypeSignedInteger;
+  }
+  switch (k) {
+  case CXType_Float:
+  case CXType_Double:
+  case CXType_LongDouble:
+  case CXType_Float128:
+  case CXType_Half:
+  case CXType_Float16:
+  case CXType_BFloat16:
+  case CXType_Ibm128:
+    flags |= kTypeFloating;
+    break;
+  case CXType_Pointer:
+  case CXType_BlockPointer:
+  case CXType_ObjCObjectPointer:
+  case CXType_MemberPointer:
+    flags |= kTypePointer;
+    break;
+  case CXType_LValueReference:
+  case CXType_RValueReference:
+    flags |= kTypeReference;
+    break;
+  case CXType_ConstantArray:
+  case CXType_IncompleteArray:
+  case CXType_VariableArray:
+  case CXType_DependentSizedArray:
+    flags |= kTypeArray;
+    break;
+  case CXType_Vector:
+  case CXType_ExtVector:
+    flags |= kTypeVector;
+    break;
+  case CXType_FunctionNoProto:
+  case CXType_FunctionProto:
+    flags |= kTypeFunction;
+    break;
+  case CXType_Typedef:
+  case CXType_Elaborated:
+  case CXType_Attributed:
+  case CXType_BTFTagAttributed:
+    flags |= kTypeSugar;
+    break;
+  default:
+    break;
+  }
+  if (InRange(k, CXType_Pipe, CXType_OCLReserveID) ||
+      InRange(k, CXType_OCLIntelSubgroupAVCMcePayload,
+              CXType_OCLIntelSubgroupAVCImeDualRefStreamin)) {
+    flags |= kTypeOpenCL;
+  }
+  return flags;
+}
+
+template <size_t N>
+constexpr std::array<uint32_t, N> MakeTable(uint32_t (*flags_of)(int)) {
+  std::array<uint32_t, N> table{};
+  for (size_t k = 0; k < N; ++k) {
+    table[k] = flags_of(static_cast<int>(k));
+  }
+  return table;
+}
+
+inline constexpr auto kCursorKindTable =
+    MakeTable<kNumCursorKinds>(&CursorKindFlagsOf);
+inline constexpr auto kTypeKindTable =
+    MakeTable<kNumTypeKinds>(&TypeKindFlagsOf);
+
+/// Flags of `kind` in `table`, kinds outside the table have none.
+template <size_t N>
+inline uint32_t Lookup(const std::array<uint32_t, N> &table, int64_t kind) {
+  return kind >= 0 && static_cast<uint64_t>(kind) < N
+             ? table[static_cast<size_t>(kind)]
+             : 0;
+}
+
+inline uint32_t CursorKindFlags(int64_t kind) {
+  return Lookup(kCursorKindTable, kind);
+}
+
+inline uint32_t TypeKindFlags(int64_t kind) {
+  return Lookup(kTypeKindTable, kind);
+}
+
+/// Every CXCursorKind enumerator, the First/Last ranges of Index.h. Other
+/// values must not reach clang_getCursorKindSpelling(), it has no spelling
+/// for them.
+inline std::vector<int64_t> CursorKinds() {
+  constexpr int ranges[][2] = {
+      {CXCursor_FirstDecl, CXCursor_LastDecl},
+      {CXCursor_FirstRef, CXCursor_LastRef},
+      {CXCursor_FirstInvalid, CXCursor_LastInvalid},
+      {CXCursor_FirstExpr, CXCursor_LastExpr},
+      {CXCursor_FirstStmt, CXCursor_LastStmt},
+      {CXCursor_TranslationUnit, CXCursor_TranslationUnit},
+      {CXCursor_FirstAttr, CXCursor_LastAttr},
+      {CXCursor_FirstPreprocessing, CXCursor_LastPreprocessing},
+      {CXCursor_FirstExtraDecl, CXCursor_LastExtraDecl},
+      {CXCursor_OverloadCandidate, CXCursor_OverloadCandidate},
+  };
+  std::vector<int64_t> kinds;
+  for (const auto &range : ranges) {
+    for (int k = range[0]; k <= range[1]; ++k) {
+      kinds.push_back(k);
+    }
+  }
+  return kinds;
+}
+
+/// Every kind below kNumTypeKinds. clang_getTypeKindSpelling() returns a
+/// null string for the values that are no CXTypeKind.
+inline std::vector<int64_t> TypeKinds() {
+  std::vector<int64_t> kinds(kNumTypeKinds);
+  for (size_t k = 0; k < kNumTypeKinds; ++k) {
+    kinds[k] = static_cast<int64_t>(k);
+  }
+  return kinds;
+}
+
+/// Spellings indexed by kind. libclang only knows spellings for enumerators
+/// it defines, so the table is filled once from a list of valid kinds and
+/// unknown kinds spell as "".
+class SpellingTable {
+public:
+  template <class SpellFnT>
+  void Fill(const std::vector<int64_t> &kinds, SpellFnT &&spell) {
+    for (auto kind : kinds) {
+      if (kind < 0) {
+        continue;
+      }
+      auto k = static_cast<size_t>(kind);
+      if (k >= spellings_.size()) {
+        spellings_.resize(k + 1);
+      }
+      if (spellings_[k].empty()) {
+        CXString s = spell(static_cast<int>(kind));
+        const char *c_str = clang_getCString(s);
+        spellings_[k] = c_str ? c_str : "";
+        clang_disposeString(s);
+      }
+    }
+  }
+
+  std::string_view Get(int64_t kind) const {
+    if (kind < 0 || static_cast<uint64_t>(kind) >= spellings_.size()) {
+      return {};
+    }
+    return spellings_[static_cast<size_t>(kind)];
+  }
+
+  size_t size() const { return spellings_.size(); }
+
+private:
+  std::vector<std::string> spellings_;
+};
+
+} // namespace kind_tables
+
+#endif // PYLIBCLANG_KIND_TABLES_H
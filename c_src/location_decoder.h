@@ -0,0 +1,124 @@
+//
+// License: MIT
+//
+
+#ifndef PYLIBCLANG_LOCATION_DECODER_H
+#define PYLIBCLANG_LOCATION_DECODER_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "clang-c/Index.h"
+
+/// Decodes CXSourceLocation into (file id, line, column, offset) for a single
+/// translation unit.
+///
+/// CXFile handles are interned to small integer ids, decoded locations are
+/// kept in a LRU cache of bounded capacity. The decoder must not outlive the
+/// translation unit its locations belong to.
+class LocationDecoder {
+public:
+  struct Decoded {
+    int32_t file = -1; // -1 when the location has no file
+    unsigned line = 0;
+    unsigned column = 0;
+    unsigned offset = 0;
+  };
+
+  explicit LocationDecoder(size_t capacity) : capacity_(capacity) {}
+
+  Decoded Decode(CXSourceLocation loc) {
+    Key key{loc.ptr_data[0], loc.ptr_data[1], loc.int_data};
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      ++hits_;
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return it->second->second;
+    }
+    ++misses_;
+    Decoded d;
+    CXFile f;
+    clang_getInstantiationLocation(loc, &f, &d.line, &d.column, &d.offset);
+    d.file = FileId(f);
+    if (capacity_ == 0) {
+      return d;
+    }
+    if (lru_.size() >= capacity_) {
+      index_.erase(lru_.back().first);
+      lru_.pop_back();
+    }
+    lru_.emplace_front(key, d);
+    index_.emplace(key, lru_.begin());
+    return d;
+  }
+
+  std::vector<Decoded> DecodeMany(const std::vector<CXSourceLocation> &locs) {
+    std::vector<Decoded> out;
+    out.reserve(locs.size());
+    for (auto &loc : locs) {
+      out.push_back(Decode(loc));
+    }
+    return out;
+  }
+
+  int32_t FileId(CXFile f) {
+    if (!f) {
+      return -1;
+    }
+    auto it = file_ids_.find(f);
+    if (it != file_ids_.end()) {
+      return it->second;
+    }
+    auto id = static_cast<int32_t>(files_.size());
+    files_.push_back(f);
+    file_ids_.emplace(f, id);
+    return id;
+  }
+
+  CXFile File(int32_t id) const {
+    return id < 0 ? nullptr : files_.at(static_cast<size_t>(id));
+  }
+
+  size_t NumFiles() const { return files_.size(); }
+  size_t Size() const { return lru_.size(); }
+  size_t Capacity() const { return capacity_; }
+  uint64_t Hits() const { return hits_; }
+  uint64_t Misses() const { return misses_; }
+
+  void Clear() {
+    lru_.clear();
+    index_.clear();
+  }
+
+private:
+  struct Key {
+    const void *p0;
+    const void *p1;
+    unsigned i;
+    bool operator==(const Key &rhs) const {
+      return p0 == rhs.p0 && p1 == rhs.p1 && i == rhs.i;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key &k) const {
+      size_t h = std::hash<const void *>()(k.p0);
+      h = h * 31 + std::hash<const void *>()(k.p1);
+      return h * 31 + std::hash<unsigned>()(k.i);
+    }
+  };
+  using LruT = std::list<std::pair<Key, Decoded>>;
+
+  size_t capacity_;
+  LruT lru_;
+  std::unordered_map<Key, LruT::iterator, KeyHash> index_;
+  std::unordered_map<CXFile, int32_t> file_ids_;
+  std::vector<CXFile> files_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+#endif // PYLIBCLANG_LOCATION_DECODER_H
@@ -0,0 +1,172 @@
+//
+// License: MIT
+//
+
+#ifndef PYLIBCLANG_PARSE_POOL_H
+#define PYLIBCLANG_PARSE_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clang-c/Index.h"
+
+/// Parses translation units on a fixed set of native threads.
+///
+/// Worker `i` only ever touches `indexes[i]`, so a CXIndex is never shared
+/// between threads. The indexes are owned by the caller and must outlive both
+/// the pool and every translation unit it produced.
+class ParsePool {
+public:
+  struct Job {
+    int64_t id = 0;
+    // Used as-is by clang_parseTranslationUnit2 when `full_argv` is false,
+    // otherwise `args[0]` is the compiler executable and the source file is
+    // part of the command line.
+    std::string filename;
+    std::vector<std::string> args;
+    bool full_argv = false;
+    unsigned options = 0;
+  };
+
+  struct Result {
+    int64_t id = 0;
+    int worker = 0;
+    CXTranslationUnit tu = nullptr;
+    CXErrorCode error = CXError_Success;
+  };
+
+  explicit ParsePool(std::vector<CXIndex> indexes)
+      : indexes_(std::move(indexes)) {
+    for (size_t i = 0; i < indexes_.size(); ++i) {
+      workers_.emplace_back([this, i] { WorkerLoop(static_cast<int>(i)); });
+    }
+  }
+
+  ParsePool(const ParsePool &) = delete;
+  ParsePool &operator=(const ParsePool &) = delete;
+
+  ~ParsePool() { Shutdown(); }
+
+  void Submit(Job job) {
+    {
+      std::lock_guard<std::mutex> _(mu_);
+      if (stopped_) {
+        throw std::runtime_error("pool is shut down");
+      }
+      jobs_.push_back(std::move(job));
+      ++pending_;
+    }
+    job_cv_.notify_one();
+  }
+
+  /// Block until a job finishes and return it in completion order, or return
+  /// nothing once every submitted job has been handed out.
+  std::optional<Result> Next() {
+    std::unique_lock<std::mutex> lock(mu_);
+    result_cv_.wait(lock, [this] { return !results_.empty() || pending_ == 0; });
+    if (results_.empty()) {
+      return std::nullopt;
+    }
+    Result r = results_.front();
+    results_.pop_front();
+    --pending_;
+    return r;
+  }
+
+  /// Jobs submitted but not yet returned by Next().
+  size_t Pending() {
+    std::lock_guard<std::mutex> _(mu_);
+    return pending_;
+  }
+
+  /// Drop queued jobs, wait for running ones and dispose every translation
+  /// unit that was never handed out.
+  void Shutdown() {
+    {
+      std::lock_guard<std::mutex> _(mu_);
+      if (stopped_) {
+        return;
+      }
+      stopped_ = true;
+      jobs_.clear();
+    }
+    job_cv_.notify_all();
+    for (auto &t : workers_) {
+      t.join();
+    }
+    {
+      std::lock_guard<std::mutex> _(mu_);
+      for (auto &r : results_) {
+        if (r.tu) {
+          clang_disposeTranslationUnit(r.tu);
+        }
+      }
+      results_.clear();
+      pending_ = 0;
+    }
+    result_cv_.notify_all();
+  }
+
+private:
+  void WorkerLoop(int worker) {
+    while (true) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mu_);
+        job_cv_.wait(lock, [this] { return stopped_ || !jobs_.empty(); });
+        if (stopped_) {
+          return;
+        }
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+      }
+      Result r = Parse(worker, job);
+      {
+        std::lock_guard<std::mutex> _(mu_);
+        results_.push_back(r);
+      }
+      result_cv_.notify_one();
+    }
+  }
+
+  Result Parse(int worker, const Job &job) {
+    std::vector<const char *> c_args;
+    c_args.reserve(job.args.size());
+    for (auto &a : job.args) {
+      c_args.push_back(a.c_str());
+    }
+    Result r;
+    r.id = job.id;
+    r.worker = worker;
+    if (job.full_argv) {
+      r.error = clang_parseTranslationUnit2FullArgv(
+          indexes_[worker], nullptr, c_args.data(),
+          static_cast<int>(c_args.size()), nullptr, 0, job.options, &r.tu);
+    } else {
+      r.error = clang_parseTranslationUnit2(
+          indexes_[worker], job.filename.empty() ? nullptr : job.filename.c_str(),
+          c_args.data(), static_cast<int>(c_args.size()), nullptr, 0,
+          job.options, &r.tu);
+    }
+    return r;
+  }
+
+  std::vector<CXIndex> indexes_;
+  std::vector<std::thread> workers_;
+  std::mutex mu_;
+  std::condition_variable job_cv_;
+  std::condition_variable result_cv_;
+  std::deque<Job> jobs_;
+  std::deque<Result> results_;
+  size_t pending_ = 0;
+  bool stopped_ = false;
+};
+
+#endif // PYLIBCLANG_PARSE_POOL_H
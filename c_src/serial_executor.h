@@ -0,0 +1,159 @@
+//
+// License: MIT
+//
+
+#ifndef PYLIBCLANG_SERIAL_EXECUTOR_H
+#define PYLIBCLANG_SERIAL_EXECUTOR_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/// Runs tasks on a fixed set of native threads, serialized per key.
+///
+/// Tasks submitted with the same non-zero key run one at a time in
+/// submission order, so a key that names a libclang object (a
+/// CXTranslationUnit, a CXIndex) is never touched by two threads at once.
+/// Different keys, and tasks with key 0, run in parallel.
+class SerialExecutor {
+public:
+  using Task = std::function<void()>;
+
+  explicit SerialExecutor(size_t workers) {
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); ++i) {
+      workers_.emplace_back([this] { WorkerLoop(); });
+    }
+  }
+
+  SerialExecutor(const SerialExecutor &) = delete;
+  SerialExecutor &operator=(const SerialExecutor &) = delete;
+
+  ~SerialExecutor() { Shutdown(); }
+
+  void Submit(uintptr_t key, Task task) {
+    {
+      std::lock_guard<std::mutex> _(mu_);
+      if (stopped_) {
+        throw std::runtime_error("executor is shut down");
+      }
+      if (!key) {
+        ready_.push_back({0, std::move(task)});
+      } else {
+        auto &strand = strands_[key];
+        strand.push_back(std::move(task));
+        // Only an idle key is made runnable here, a busy one is requeued by
+        // the worker running it.
+        if (strand.size() == 1 && !running_.count(key)) {
+          ready_.push_back({key, {}});
+        }
+      }
+    }
+    cv_.notify_one();
+  }
+
+  /// Tasks submitted but not finished.
+  size_t Pending() {
+    std::lock_guard<std::mutex> _(mu_);
+    size_t n = running_count_;
+    for (auto &r : ready_) {
+      n += !r.first;
+    }
+    for (auto &s : strands_) {
+      n += s.second.size();
+    }
+    return n;
+  }
+
+  /// Stop after the running tasks and return the tasks that never ran, so
+  /// the caller can dispose of them in the right context.
+  std::vector<Task> Shutdown() {
+    std::vector<Task> dropped;
+    {
+      std::lock_guard<std::mutex> _(mu_);
+      if (stopped_) {
+        return dropped;
+      }
+      stopped_ = true;
+    }
+    cv_.notify_all();
+    for (auto &t : workers_) {
+      t.join();
+    }
+    std::lock_guard<std::mutex> _(mu_);
+    for (auto &r : ready_) {
+      if (!r.first) {
+        dropped.push_back(std::move(r.second));
+      }
+    }
+    for (auto &s : strands_) {
+      for (auto &task : s.second) {
+        dropped.push_back(std::move(task));
+      }
+    }
+    ready_.clear();
+    strands_.clear();
+    return dropped;
+  }
+
+private:
+  void WorkerLoop() {
+    while (true) {
+      uintptr_t key;
+      Task task;
+      {
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_.wait(lock, [this] { return stopped_ || !ready_.empty(); });
+        if (stopped_) {
+          return;
+        }
+        key = ready_.front().first;
+        task = std::move(ready_.front().second);
+        ready_.pop_front();
+        if (key) {
+          auto &strand = strands_[key];
+          task = std::move(strand.front());
+          strand.pop_front();
+          running_.insert(key);
+        }
+        ++running_count_;
+      }
+      task();
+      task = nullptr;
+      {
+        std::lock_guard<std::mutex> _(mu_);
+        --running_count_;
+        if (key) {
+          running_.erase(key);
+          auto it = strands_.find(key);
+          if (it->second.empty()) {
+            strands_.erase(it);
+          } else {
+            ready_.push_back({key, {}});
+            cv_.notify_one();
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  // Runnable entries: a task with key 0, or a key whose strand goes next.
+  std::deque<std::pair<uintptr_t, Task>> ready_;
+  std::unordered_map<uintptr_t, std::deque<Task>> strands_;
+  std::unordered_set<uintptr_t> running_;
+  size_t running_count_ = 0;
+  bool stopped_ = false;
+};
+
+#endif // PYLIBCLANG_SERIAL_EXECUTOR_H
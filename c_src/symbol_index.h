@@ -0,0 +1,473 @@
+//
+// License: MIT
+//
+
+#ifndef PYLIBCLANG_SYMBOL_INDEX_H
+#define PYLIBCLANG_SYMBOL_INDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// On-disk symbol index, in host byte order:
+///
+///   Header
+///   symbols   string table of the USRs, sorted bytewise
+///   ranges    uint32 [num_symbols + 1], postings of symbol i are
+///             postings[ranges[i], ranges[i + 1])
+///   postings  Posting [num_postings], sorted by (file, offset, role, unit)
+///             within a symbol
+///   files     string table
+///   units     string table of the units (translation units) postings came
+///             from, so an index can be loaded and updated per unit
+///
+/// A string table of n strings is uint32 [n + 1] offsets relative to the end
+/// of the offset array, followed by the characters. Sections are 8 aligned.
+namespace symbol_index {
+
+constexpr char kMagic[8] = {'P', 'L', 'C', 'S', 'Y', 'M', 'I', 'X'};
+constexpr uint32_t kVersion = 1;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_symbols;
+  uint32_t num_postings;
+  uint32_t num_files;
+  uint32_t num_units;
+  uint32_t reserved;
+  uint64_t symbols_offset;
+  uint64_t ranges_offset;
+  uint64_t postings_offset;
+  uint64_t files_offset;
+  uint64_t units_offset;
+  uint64_t size;
+};
+
+struct Posting {
+  uint32_t file;
+  uint32_t line;
+  uint32_t column;
+  uint32_t offset;
+  uint32_t role; // CXSymbolRole bits
+  uint32_t unit;
+
+  bool SameLocation(const Posting &rhs) const {
+    return file == rhs.file && offset == rhs.offset && role == rhs.role;
+  }
+};
+
+/// Read-only view of a string table inside a mapped index.
+class StringTable {
+public:
+  StringTable() = default;
+  StringTable(const char *base, size_t size, uint32_t n) : n_(n) {
+    size_t offsets_size = (static_cast<size_t>(n) + 1) * sizeof(uint32_t);
+    if (offsets_size > size) {
+      throw std::runtime_error("symbol index: truncated string table");
+    }
+    offsets_ = reinterpret_cast<const uint32_t *>(base);
+    chars_ = base + offsets_size;
+    if (offsets_[n] > size - offsets_size) {
+      throw std::runtime_error("symbol index: truncated string table");
+    }
+    // With non-decreasing offsets every string ends inside the table.
+    for (uint32_t i = 0; i < n; ++i) {
+      if (offsets_[i] > offsets_[i + 1]) {
+        throw std::runtime_error("symbol index: corrupt string table");
+      }
+    }
+  }
+
+  uint32_t size() const { return n_; }
+  std::string_view at(uint32_t i) const {
+    if (i >= n_) {
+      throw std::out_of_range("symbol index: string id out of range");
+    }
+    return std::string_view(chars_ + offsets_[i],
+                            offsets_[i + 1] - offsets_[i]);
+  }
+
+private:
+  uint32_t n_ = 0;
+  const uint32_t *offsets_ = nullptr;
+  const char *chars_ = nullptr;
+};
+
+/// Memory-maps an index file and answers USR lookups by binary search over
+/// the sorted USR table.
+class Reader {
+public:
+  explicit Reader(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("symbol index: can not open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(Header)) {
+      ::close(fd);
+      throw std::runtime_error("symbol index: not an index file: " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void *p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      throw std::runtime_error("symbol index: can not map " + path);
+    }
+    data_ = static_cast<const char *>(p);
+    try {
+      Validate();
+    } catch (...) {
+      Close();
+      throw;
+    }
+  }
+
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+
+  ~Reader() { Close(); }
+
+  void Close() {
+    if (data_) {
+      ::munmap(const_cast<char *>(data_), size_);
+      data_ = nullptr;
+    }
+  }
+
+  bool Closed() const { return data_ == nullptr; }
+  uint32_t NumSymbols() const { return header().num_symbols; }
+  uint32_t NumPostings() const { return header().num_postings; }
+  const StringTable &Symbols() const { return symbols_; }
+  const StringTable &Files() const { return files_; }
+  const StringTable &Units() const { return units_; }
+
+  /// Index of `usr` in the symbol table, or -1.
+  int64_t Find(std::string_view usr) const {
+    uint32_t i = LowerBound(usr);
+    if (i < NumSymbols() && symbols_.at(i) == usr) {
+      return i;
+    }
+    return -1;
+  }
+
+  /// First symbol not less than `usr`.
+  uint32_t LowerBound(std::string_view usr) const {
+    uint32_t lo = 0, hi = NumSymbols();
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (symbols_.at(mid) < usr) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  const Posting *PostingsBegin(uint32_t symbol) const {
+    return postings_ + ranges_[symbol];
+  }
+  const Posting *PostingsEnd(uint32_t symbol) const {
+    return postings_ + ranges_[symbol + 1];
+  }
+
+  /// Postings of `symbol` with any bit of `role_mask` set (all when 0). The
+  /// same location reported by several units is returned once.
+  std::vector<Posting> Lookup(uint32_t symbol, uint32_t role_mask) const {
+    std::vector<Posting> out;
+    for (auto *p = PostingsBegin(symbol); p != PostingsEnd(symbol); ++p) {
+      if (role_mask && !(p->role & role_mask)) {
+        continue;
+      }
+      if (!out.empty() && out.back().SameLocation(*p)) {
+        continue;
+      }
+      out.push_back(*p);
+    }
+    return out;
+  }
+
+private:
+  const Header &header() const {
+    return *reinterpret_cast<const Header *>(data_);
+  }
+
+  StringTable Table(uint64_t offset, uint32_t n) const {
+    if (offset > size_) {
+      throw std::runtime_error("symbol index: corrupt section offset");
+    }
+    return StringTable(data_ + offset, size_ - offset, n);
+  }
+
+  void Validate() {
+    const Header &h = header();
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 ||
+        h.version != kVersion || h.size != size_) {
+      throw std::runtime_error("symbol index: bad header");
+    }
+    symbols_ = Table(h.symbols_offset, h.num_symbols);
+    files_ = Table(h.files_offset, h.num_files);
+    units_ = Table(h.units_offset, h.num_units);
+    size_t ranges_size = (static_cast<size_t>(h.num_symbols) + 1) * 4;
+    size_t postings_size =
+        static_cast<size_t>(h.num_postings) * sizeof(Posting);
+    if (h.ranges_offset > size_ || ranges_size > size_ - h.ranges_offset ||
+        h.postings_offset > size_ ||
+        postings_size > size_ - h.postings_offset) {
+      throw std::runtime_error("symbol index: truncated postings");
+    }
+    ranges_ = reinterpret_cast<const uint32_t *>(data_ + h.ranges_offset);
+    postings_ = reinterpret_cast<const Posting *>(data_ + h.postings_offset);
+    // Non-decreasing and ending at num_postings, so every range lies
+    // inside the postings.
+    if (ranges_[h.num_symbols] != h.num_postings) {
+      throw std::runtime_error("symbol index: corrupt posting ranges");
+    }
+    for (uint32_t i = 0; i < h.num_symbols; ++i) {
+      if (ranges_[i] > ranges_[i + 1]) {
+        throw std::runtime_error("symbol index: corrupt posting ranges");
+      }
+    }
+  }
+
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  StringTable symbols_;
+  StringTable files_;
+  StringTable units_;
+  const uint32_t *ranges_ = nullptr;
+  const Posting *postings_ = nullptr;
+};
+
+/// Accumulates postings per unit and writes an index file. Adding a unit
+/// again replaces its previous postings, so an index can be kept current by
+/// loading it, re-adding the units that changed and writing it back.
+class Builder {
+public:
+  struct Entry {
+    uint32_t usr;
+    Posting posting; // `unit` is unused here
+  };
+
+  uint32_t InternUsr(std::string_view usr) {
+    return Intern(usrs_, usr_ids_, usr);
+  }
+  uint32_t InternFile(std::string_view file) {
+    return Intern(files_, file_ids_, file);
+  }
+
+  /// Drop the postings of `unit` and return the buffer to fill with its new
+  /// ones.
+  std::vector<Entry> &ResetUnit(const std::string &unit) {
+    auto &entries = units_[unit];
+    entries.clear();
+    return entries;
+  }
+
+  bool RemoveUnit(const std::string &unit) { return units_.erase(unit) > 0; }
+
+  std::vector<std::string> UnitNames() const {
+    std::vector<std::string> out;
+    for (auto &kv : units_) {
+      out.push_back(kv.first);
+    }
+    return out;
+  }
+
+  size_t NumPostings() const {
+    size_t n = 0;
+    for (auto &kv : units_) {
+      n += kv.second.size();
+    }
+    return n;
+  }
+
+  /// Add every posting of an existing index, keeping its units.
+  void Load(const Reader &reader) {
+    std::vector<std::vector<Entry> *> units;
+    for (uint32_t u = 0; u < reader.Units().size(); ++u) {
+      units.push_back(&ResetUnit(std::string(reader.Units().at(u))));
+    }
+    std::vector<uint32_t> files;
+    for (uint32_t f = 0; f < reader.Files().size(); ++f) {
+      files.push_back(InternFile(reader.Files().at(f)));
+    }
+    for (uint32_t s = 0; s < reader.NumSymbols(); ++s) {
+      uint32_t usr = InternUsr(reader.Symbols().at(s));
+      for (auto *p = reader.PostingsBegin(s); p != reader.PostingsEnd(s); ++p) {
+        Entry e{usr, *p};
+        e.posting.file = files.at(p->file);
+        units.at(p->unit)->push_back(e);
+      }
+    }
+  }
+
+  /// Write the index to `path` through a temporary file renamed into place.
+  void Write(const std::string &path) const {
+    // Only symbols and files still referenced by some unit are written.
+    std::vector<uint32_t> usr_map(usrs_.size(), kUnused);
+    std::vector<uint32_t> file_map(files_.size(), kUnused);
+    for (auto &kv : units_) {
+      for (auto &e : kv.second) {
+        usr_map[e.usr] = 0;
+        file_map[e.posting.file] = 0;
+      }
+    }
+    std::vector<uint32_t> symbols = SortedUsed(usrs_, usr_map);
+    std::vector<uint32_t> files = SortedUsed(files_, file_map);
+
+    std::vector<std::pair<uint32_t, Posting>> all;
+    all.reserve(NumPostings());
+    std::vector<std::string_view> unit_names;
+    for (auto &kv : units_) {
+      auto unit = static_cast<uint32_t>(unit_names.size());
+      unit_names.push_back(kv.first);
+      for (auto &e : kv.second) {
+        Posting p = e.posting;
+        p.file = file_map[p.file];
+        p.unit = unit;
+        all.emplace_back(usr_map[e.usr], p);
+      }
+    }
+    auto order = [](const std::pair<uint32_t, Posting> &e) {
+      return std::tie(e.first, e.second.file, e.second.offset, e.second.role,
+                      e.second.unit);
+    };
+    std::sort(all.begin(), all.end(),
+              [&](auto &a, auto &b) { return order(a) < order(b); });
+
+    std::string out(sizeof(Header), '\0');
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.num_symbols = static_cast<uint32_t>(symbols.size());
+    h.num_postings = static_cast<uint32_t>(all.size());
+    h.num_files = static_cast<uint32_t>(files.size());
+    h.num_units = static_cast<uint32_t>(unit_names.size());
+
+    h.symbols_offset = AppendTable(out, usrs_, symbols);
+    Align(out);
+    h.ranges_offset = out.size();
+    std::vector<uint32_t> ranges(symbols.size() + 1, 0);
+    for (auto &e : all) {
+      ++ranges[e.first + 1];
+    }
+    std::partial_sum(ranges.begin(), ranges.end(), ranges.begin());
+    Append(out, ranges.data(), ranges.size() * sizeof(uint32_t));
+    Align(out);
+    h.postings_offset = out.size();
+    for (auto &e : all) {
+      Append(out, &e.second, sizeof(Posting));
+    }
+    h.files_offset = AppendTable(out, files_, files);
+    std::vector<std::string> unit_strings(unit_names.begin(), unit_names.end());
+    std::vector<uint32_t> unit_order(unit_strings.size());
+    std::iota(unit_order.begin(), unit_order.end(), 0);
+    h.units_offset = AppendTable(out, unit_strings, unit_order);
+    h.size = out.size();
+    std::memcpy(&out[0], &h, sizeof(h));
+
+    std::string tmp = path + ".tmp" + std::to_string(::getpid());
+    {
+      std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+      f.write(out.data(), static_cast<std::streamsize>(out.size()));
+      if (!f) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("symbol index: can not write " + tmp);
+      }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+      std::remove(tmp.c_str());
+      throw std::runtime_error("symbol index: can not replace " + path);
+    }
+  }
+
+private:
+  static constexpr uint32_t kUnused = UINT32_MAX;
+
+  static uint32_t Intern(std::vector<std::string> &strings,
+                         std::unordered_map<std::string, uint32_t> &ids,
+                         std::string_view s) {
+    std::string key(s);
+    auto it = ids.find(key);
+    if (it != ids.end()) {
+      return it->second;
+    }
+    auto id = static_cast<uint32_t>(strings.size());
+    strings.push_back(key);
+    ids.emplace(std::move(key), id);
+    return id;
+  }
+
+  /// Ids with `map[id] != kUnused` in bytewise order of their strings, `map`
+  /// is rewritten to the position of each id in that order.
+  static std::vector<uint32_t>
+  SortedUsed(const std::vector<std::string> &strings,
+             std::vector<uint32_t> &map) {
+    std::vector<uint32_t> used;
+    for (uint32_t i = 0; i < map.size(); ++i) {
+      if (map[i] != kUnused) {
+        used.push_back(i);
+      }
+    }
+    std::sort(used.begin(), used.end(), [&](uint32_t a, uint32_t b) {
+      return strings[a] < strings[b];
+    });
+    for (uint32_t i = 0; i < used.size(); ++i) {
+      map[used[i]] = i;
+    }
+    return used;
+  }
+
+  static void Append(std::string &out, const void *p, size_t n) {
+    out.append(static_cast<const char *>(p), n);
+  }
+
+  static void Align(std::string &out) {
+    out.resize((out.size() + 7) & ~size_t(7), '\0');
+  }
+
+  static uint64_t AppendTable(std::string &out,
+                              const std::vector<std::string> &strings,
+                              const std::vector<uint32_t> &order) {
+    Align(out);
+    uint64_t begin = out.size();
+    uint32_t offset = 0;
+    for (auto i : order) {
+      Append(out, &offset, sizeof(offset));
+      offset += static_cast<uint32_t>(strings[i].size());
+    }
+    Append(out, &offset, sizeof(offset));
+    for (auto i : order) {
+      out.append(strings[i]);
+    }
+    return begin;
+  }
+
+  std::vector<std::string> usrs_;
+  std::unordered_map<std::string, uint32_t> usr_ids_;
+  std::vector<std::string> files_;
+  std::unordered_map<std::string, uint32_t> file_ids_;
+  std::map<std::string, std::vector<Entry>> units_;
+};
+
+} // namespace symbol_index
+
+#endif // PYLIBCLANG_SYMBOL_INDEX_H
@@ -47,8 +47,16 @@ from __future__ import absolute_import, division, print_function
 
 import os
 import sys
+import asyncio
+import atexit
+import collections
+import concurrent.futures
 import functools
 import inspect
+import itertools
+import hashlib
+import json
+import tempfile
 
 from pylibclang import _C
 
@@ -95,6 +103,14 @@ class TranslationUnitLoadError(Exception):
     pass
 
 
+class SerializedDiagnosticsError(Exception):
+    """Represents an error that occurred when reading a serialized diagnostics
+    (.dia) file, e.g. a missing file or an unsupported format version.
+    """
+
+    pass
+
+
 class TranslationUnitSaveError(Exception):
     """Represents an error that occurred when saving a TranslationUnit.
 
@@ -179,6 +195,54 @@ def _enhance(target_type):
     return deco
 
 
+# Asynchronous calls in flight over all translation units. The _sync_only
+# guards only look up the translation unit while it is non-zero.
+_async_calls = 0
+
+
+def _sync_only(func):
+    """Make func raise RuntimeError while the translation unit it works on
+    has asynchronous calls in flight, see TranslationUnit.reparse_async()."""
+
+    @functools.wraps(func)
+    def guarded(self, *args, **kwargs):
+        if _async_calls:
+            if isinstance(self, TranslationUnit):
+                tu = self
+            else:
+                tu = getattr(self, "_tu", None)
+            if tu is not None:
+                tu._check_no_async()
+        return func(self, *args, **kwargs)
+
+    return guarded
+
+
+def _sync_only_methods(cls):
+    """Apply _sync_only to the public methods and properties of cls.
+
+    Static and class methods, coroutines and names starting with an
+    underscore are left alone.
+    """
+    for name, attr in list(vars(cls).items()):
+        if name.startswith("_"):
+            continue
+        if isinstance(attr, property):
+            setattr(
+                cls,
+                name,
+                property(
+                    _sync_only(attr.fget),
+                    attr.fset and _sync_only(attr.fset),
+                    attr.fdel,
+                    attr.__doc__,
+                ),
+            )
+        elif inspect.isfunction(attr) and not inspect.iscoroutinefunction(attr):
+            setattr(cls, name, _sync_only(attr))
+    return cls
+
+
 def _result_as(cls):
     def deco(func):
         """Convert the result of func to cls"""
@@ -209,15 +273,22 @@ class _CXString:
 
 
 @_enhance(_C.CXSourceLocation)
+@_sync_only_methods
 class SourceLocation:
     """
     A SourceLocation represents a particular location within a source file.
     """
 
-    @functools.cache
     def _get_instantiation(self):
-        f, l, c, o = conf.lib.clang_getInstantiationLocation(self)
-        return File(f), l, c, o
+        if not hasattr(self, "_instantiation"):
+            tu = getattr(self, "_tu", None)
+            if tu is not None:
+                # Decoded through the bounded per-TU cache.
+                self._instantiation = tu.decode_locations([self])[0]
+            else:
+                f, l, c, o = conf.lib.clang_getInstantiationLocation(self)
+                self._instantiation = File(f), l, c, o
+        return self._instantiation
 
     @staticmethod
     def from_position(tu, file, line, column):
@@ -225,7 +296,9 @@ class SourceLocation:
         Retrieve the source location associated with a given file/line/column in
         a particular translation unit.
         """
-        return conf.lib.clang_getLocation(tu, file, line, column)
+        loc = conf.lib.clang_getLocation(tu, file, line, column)
+        loc._tu = tu
+        return loc
 
     @staticmethod
     def from_offset(tu, file, offset):
@@ -235,7 +308,9 @@ class SourceLocation:
         file -- File instance to obtain offset from
         offset -- Integer character offset within file
         """
-        return conf.lib.clang_getLocationForOffset(tu, file, offset)
+        loc = conf.lib.clang_getLocationForOffset(tu, file, offset)
+        loc._tu = tu
+        return loc
 
     @property
     def file(self):
@@ -281,6 +356,7 @@ class SourceLocation:
 
 
 @_enhance(_C.CXSourceRange)
+@_sync_only_methods
 class SourceRange:
     """
     A SourceRange describes a range of source locations within the source
@@ -476,6 +552,53 @@ class Diagnostic(ClangObject):
             raise ValueError("Invalid format options")
         return conf.lib.clang_formatDiagnostic(self, options)
 
+    @staticmethod
+    def read_serialized(paths, workers=1, max_in_flight=None):
+        """Read serialized diagnostics (.dia) files, as written by
+        -serialize-diagnostics.
+
+        Each file is decoded natively into a `_C.PackedDiagnostics` in one
+        call, see TranslationUnit.diagnostics_packed for its layout. With
+        workers > 1 the files are read on a thread pool, at most max_in_flight
+        (2 * workers by default) at a time, so paths are consumed lazily.
+
+        Yields (path, result) pairs in the order of paths, where result is
+        either a PackedDiagnostics or a SerializedDiagnosticsError.
+        """
+        assert workers > 0
+
+        def load(path):
+            try:
+                return _C.load_diagnostics(fspath(path))
+            except RuntimeError as e:
+                return SerializedDiagnosticsError(str(e))
+
+        if workers == 1:
+            for path in paths:
+                yield path, load(path)
+            return
+
+        if max_in_flight is None:
+            max_in_flight = 2 * workers
+        assert max_in_flight > 0
+        paths = iter(paths)
+        pending = collections.deque()
+        with concurrent.futures.ThreadPoolExecutor(workers) as pool:
+            try:
+                while True:
+                    while len(pending) < max_in_flight:
+                        path = next(paths, None)
+                        if path is None:
+                            break
+                        pending.append((path, pool.submit(load, path)))
+                    if not pending:
+                        return
+                    path, future = pending.popleft()
+                    yield path, future.result()
+            finally:
+                for _, future in pending:
+                    future.cancel()
+
     def __repr__(self):
         return "<Diagnostic severity %r, location %r, spelling %r>" % (
             self.severity,
@@ -521,10 +644,25 @@ class TokenGroup(object):
         self._tu = tu
         self._first_token = memory
         self._count = count
+        self._cursors = None
 
     def __del__(self):
         conf.lib.clang_disposeTokens(self._tu, self._first_token, self._count)
 
+    def cursor(self, index):
+        """The Cursor of the token at `index` in this group.
+
+        The whole group is annotated by a single clang_annotateTokens call the
+        first time any of its tokens is asked for a cursor.
+        """
+        if self._cursors is None:
+            self._cursors = conf.lib.annotate_tokens(
+                self._tu, self._first_token, self._count
+            )
+            for cursor in self._cursors:
+                cursor._tu = self._tu
+        return self._cursors[index]
+
     @staticmethod
     def get_tokens(tu, extent):
         """Helper method to return all tokens in an extent.
@@ -547,6 +685,7 @@ class TokenGroup(object):
             token = tokens.at(i)
             token._tu = tu
             token._group = token_group
+            token._index = i
 
             yield token
 
@@ -558,43 +697,53 @@ TokenKind = _C.CXTokenKind
 class CursorKind:
     """
     A CursorKind describes the kind of entity that a cursor points to.
+
+    The category predicates and the spelling are looked up in tables built
+    into the binding. To classify many kinds at once, pass a buffer of kinds
+    (e.g. AstColumns.kind) to _C.cursor_kind_flags() or
+    _C.classify_cursor_kinds().
     """
 
+    @property
+    def spelling(self):
+        """The libclang spelling of this kind, e.g. "FunctionDecl"."""
+        return _C.cursor_kind_spelling(self)
+
     def is_declaration(self):
         """Test if this is a declaration kind."""
-        return conf.lib.clang_isDeclaration(self)
+        return _C.cursor_kind_is(self, _C.CURSOR_KIND_DECLARATION)
 
     def is_reference(self):
         """Test if this is a reference kind."""
-        return conf.lib.clang_isReference(self)
+        return _C.cursor_kind_is(self, _C.CURSOR_KIND_REFERENCE)
 
     def is_expression(self):
         """Test if this is an expression kind."""
-        return conf.lib.clang_isExpression(self)
+        return _C.cursor_kind_is(self, _C.CURSOR_KIND_EXPRESSION)
 
     def is_statement(self):
         """Test if this is a statement kind."""
-        return conf.lib.clang_isStatement(self)
+        return _C.cursor_kind_is(self, _C.CURSOR_KIND_STATEMENT)
 
     def is_attribute(self):
         """Test if this is an attribute kind."""
-        return conf.lib.clang_isAttribute(self)
+        return _C.cursor_kind_is(self, _C.CURSOR_KIND_ATTRIBUTE)
 
     def is_invalid(self):
         """Test if this is an invalid kind."""
-        return conf.lib.clang_isInvalid(self)
+        return _C.cursor_kind_is(self, _C.CURSOR_KIND_INVALID)
 
     def is_translation_unit(self):
         """Test if this is a translation unit kind."""
-        return conf.lib.clang_isTranslationUnit(self)
+        return _C.cursor_kind_is(self, _C.CURSOR_KIND_TRANSLATION_UNIT)
 
     def is_preprocessing(self):
         """Test if this is a preprocessing kind."""
-        return conf.lib.clang_isPreprocessing(self)
+        return _C.cursor_kind_is(self, _C.CURSOR_KIND_PREPROCESSING)
 
     def is_unexposed(self):
         """Test if this is an unexposed kind."""
-        return conf.lib.clang_isUnexposed(self)
+        return _C.cursor_kind_is(self, _C.CURSOR_KIND_UNEXPOSED)
 
 
 TemplateArgumentKind = _C.CXTemplateArgumentKind
@@ -605,10 +754,15 @@ ExceptionSpecificationKind = _C.CXCursor_ExceptionSpecificationKind
 
 
 @_enhance(_C.CXCursor)
+@_sync_only_methods
 class Cursor:
     """
     The Cursor class represents a reference to an element within the AST. It
     acts as a kind of iterator.
+
+    Cursors are small value objects without a __dict__: the only state kept
+    besides the CXCursor is a strong reference to the TranslationUnit, in a
+    native slot, and properties are not cached per instance.
     """
 
     @staticmethod
@@ -620,11 +774,8 @@ class Cursor:
 
         return cursor
 
-    def __eq__(self, other):
-        return conf.lib.clang_equalCursors(self, other)
-
-    def __ne__(self, other):
-        return not self.__eq__(other)
+    # __eq__, __ne__ and __hash__ are implemented natively with
+    # clang_equalCursors and clang_hashCursor.
 
     def is_definition(self):
         """
@@ -826,10 +977,7 @@ class Cursor:
     @property
     def spelling(self):
         """Return the spelling of the entity pointed at by the cursor."""
-        if not hasattr(self, "_spelling"):
-            self._spelling = conf.lib.clang_getCursorSpelling(self)
-
-        return self._spelling
+        return conf.lib.clang_getCursorSpelling(self)
 
     @property
     def displayname(self):
@@ -840,37 +988,29 @@ class Cursor:
         cursor, such as the parameters of a function or template or the
         arguments of a class template specialization.
         """
-        if not hasattr(self, "_displayname"):
-            self._displayname = conf.lib.clang_getCursorDisplayName(self)
-
-        return self._displayname
+        return conf.lib.clang_getCursorDisplayName(self)
 
     @property
     def mangled_name(self):
         """Return the mangled name for the entity referenced by this cursor."""
-        if not hasattr(self, "_mangled_name"):
-            self._mangled_name = conf.lib.clang_Cursor_getMangling(self)
-
-        return self._mangled_name
+        return conf.lib.clang_Cursor_getMangling(self)
 
     @property
-    @functools.cache
     def location(self):
         """
         Return the source location (the starting character) of the entity
         pointed at by the cursor.
         """
-
-        return conf.lib.clang_getCursorLocation(self)
+        location = conf.lib.clang_getCursorLocation(self)
+        location._tu = self._tu
+        return location
 
     @property
-    @functools.cache
     def linkage(self):
         """Return the linkage of this cursor."""
         return conf.lib.clang_getCursorLinkage(self)
 
     @property
-    @functools.cache
     def tls_kind(self):
         """Return the thread-local storage (TLS) kind of this cursor."""
         return conf.lib.clang_getCursorTLSKind(self)
@@ -881,13 +1021,9 @@ class Cursor:
         Return the source range (the range of text) occupied by the entity
         pointed at by the cursor.
         """
-        if not hasattr(self, "_extent"):
-            self._extent = conf.lib.clang_getCursorExtent(self)
-
-        return self._extent
+        return conf.lib.clang_getCursorExtent(self)
 
     @property
-    @functools.cache
     def storage_class(self):
         """
         Retrieves the storage class (if any) of the entity pointed at by the
@@ -896,7 +1032,6 @@ class Cursor:
         return conf.lib.clang_Cursor_getStorageClass(self)
 
     @property
-    @functools.cache
     def availability(self):
         """
         Retrieves the availability of the entity pointed at by the cursor.
@@ -904,7 +1039,6 @@ class Cursor:
         return conf.lib.clang_getCursorAvailability(self)
 
     @property
-    @functools.cache
     def access_specifier(self):
         """
         Retrieves the access specifier (if any) of the entity pointed at by the
@@ -914,7 +1048,6 @@ class Cursor:
         return conf.lib.clang_getCXXAccessSpecifier(self)
 
     @property
-    @functools.cache
     def type(self):
         """
         Retrieve the Type (if any) of the entity pointed at by the cursor.
@@ -930,21 +1063,14 @@ class Cursor:
         declarations for the same class, the canonical cursor for the forward
         declarations will be identical.
         """
-        if not hasattr(self, "_canonical"):
-            self._canonical = conf.lib.clang_getCanonicalCursor(self)
-
-        return self._canonical
+        return conf.lib.clang_getCanonicalCursor(self)
 
     @property
     def result_type(self):
         """Retrieve the Type of the result for this Cursor."""
-        if not hasattr(self, "_result_type"):
-            self._result_type = conf.lib.clang_getCursorResultType(self)
-
-        return self._result_type
+        return conf.lib.clang_getCursorResultType(self)
 
     @property
-    @functools.cache
     def exception_specification_kind(self):
         """
         Retrieve the exception specification kind, which is one of the values
@@ -953,7 +1079,6 @@ class Cursor:
         return conf.lib.clang_getCursorExceptionSpecificationType(self)
 
     @property
-    @functools.cache
     def underlying_typedef_type(self):
         """Return the underlying type of a typedef declaration.
 
@@ -976,66 +1101,40 @@ class Cursor:
     @property
     def enum_value(self):
         """Return the value of an enum constant."""
-        if not hasattr(self, "_enum_value"):
-            assert self.kind == CursorKind.CXCursor_EnumConstantDecl
-            # Figure out the underlying type of the enum to know if it
-            # is a signed or unsigned quantity.
-            underlying_type = self.type
-            if underlying_type.kind == TypeKind.CXType_Enum:
-                underlying_type = underlying_type.get_declaration().enum_type
-            if underlying_type.kind in (
-                    TypeKind.CXType_Char_U,
-                    TypeKind.CXType_UChar,
-                    TypeKind.CXType_Char16,
-                    TypeKind.CXType_Char32,
-                    TypeKind.CXType_UShort,
-                    TypeKind.CXType_UInt,
-                    TypeKind.CXType_ULong,
-                    TypeKind.CXType_ULongLong,
-                    TypeKind.CXType_UInt128,
-            ):
-                self._enum_value = conf.lib.clang_getEnumConstantDeclUnsignedValue(self)
-            else:
-                self._enum_value = conf.lib.clang_getEnumConstantDeclValue(self)
-        return self._enum_value
+        assert self.kind == CursorKind.CXCursor_EnumConstantDecl
+        # Figure out the underlying type of the enum to know if it
+        # is a signed or unsigned quantity.
+        underlying_type = self.type
+        if underlying_type.kind == TypeKind.CXType_Enum:
+            underlying_type = underlying_type.get_declaration().enum_type
+        if underlying_type.kind.is_unsigned_integer():
+            return conf.lib.clang_getEnumConstantDeclUnsignedValue(self)
+        return conf.lib.clang_getEnumConstantDeclValue(self)
 
     @property
     def objc_type_encoding(self):
         """Return the Objective-C type encoding as a str."""
-        if not hasattr(self, "_objc_type_encoding"):
-            self._objc_type_encoding = conf.lib.clang_getDeclObjCTypeEncoding(self)
-
-        return self._objc_type_encoding
+        return conf.lib.clang_getDeclObjCTypeEncoding(self)
 
     @property
     def hash(self):
         """Returns a hash of the cursor as an int."""
-        if not hasattr(self, "_hash"):
-            self._hash = conf.lib.clang_hashCursor(self)
-
-        return self._hash
+        return conf.lib.clang_hashCursor(self)
 
     @property
     def semantic_parent(self):
         """Return the semantic parent for this cursor."""
-        if not hasattr(self, "_semantic_parent"):
-            self._semantic_parent = conf.lib.clang_getCursorSemanticParent(self)
-
-        return self._semantic_parent
+        return conf.lib.clang_getCursorSemanticParent(self)
 
     @property
     def lexical_parent(self):
         """Return the lexical parent for this cursor."""
-        if not hasattr(self, "_lexical_parent"):
-            self._lexical_parent = conf.lib.clang_getCursorLexicalParent(self)
-
-        return self._lexical_parent
+        return conf.lib.clang_getCursorLexicalParent(self)
 
     @property
     def translation_unit(self):
         """Returns the TranslationUnit to which this Cursor belongs."""
-        # If this triggers an AttributeError, the instance was not properly
-        # created.
+        # None if the instance was not properly created.
         return self._tu
 
     @property
@@ -1044,10 +1143,7 @@ class Cursor:
         For a cursor that is a reference, returns a cursor
         representing the entity that it references.
         """
-        if not hasattr(self, "_referenced"):
-            self._referenced = conf.lib.clang_getCursorReferenced(self)
-
-        return self._referenced
+        return conf.lib.clang_getCursorReferenced(self)
 
     @property
     def brief_comment(self):
@@ -1086,24 +1182,20 @@ class Cursor:
         """Returns the value of the indicated arg as an unsigned 64b integer."""
         return conf.lib.clang_Cursor_getTemplateArgumentUnsignedValue(self, num)
 
-    def get_children(self):
-        """Return an iterator for accessing the children of this cursor."""
-
-        # FIXME: Expose iteration from CIndex, PR6125.
-        children = []
-
-        def visitor(child, parent, data):
-            # FIXME: Document this assertion in API.
-            # FIXME: There should just be an isNull method.
-            assert child != conf.lib.clang_getNullCursor()
-
+    def _walk(self, max_depth):
+        """Yield cursors of the preorder walk collected natively by
+        `_C.walk_subtree`, skipping the root itself."""
+        walk = conf.lib.walk_subtree(self, max_depth)
+        tu = self._tu
+        for i in range(1, len(walk)):
+            cursor = walk.at(i)
             # Create reference to TU so it isn't GC'd before Cursor.
-            child._tu = self._tu
-            children.append(child)
-            return _C.CXChildVisitResult.CXChildVisit_Continue
+            cursor._tu = tu
+            yield cursor
 
-        conf.lib.clang_visitChildren(self, visitor, _C.voidp(0))
-        return iter(children)
+    def get_children(self):
+        """Return an iterator for accessing the children of this cursor."""
+        return self._walk(1)
 
     def walk_preorder(self):
         """Depth-first preorder walk over the cursor and its descendants.
@@ -1111,9 +1203,90 @@ class Cursor:
         Yields cursors.
         """
         yield self
-        for child in self.get_children():
-            for descendant in child.walk_preorder():
-                yield descendant
+        yield from self._walk(-1)
+
+    def query(
+            self,
+            kinds=None,
+            spelling=None,
+            main_file_only=False,
+            skip_system_headers=False,
+            files=None,
+            max_depth=-1,
+            prune=True,
+            recurse_into_matches=True,
+    ):
+        """Return the descendants of this cursor that match all the filters.
+
+        The filters are evaluated natively while visiting, only the matching
+        cursors are materialized in Python.
+
+        kinds -- iterable of CursorKind, None for any kind.
+        spelling -- regex searched in the cursor spelling, None for any. An
+            invalid pattern raises ValueError.
+        main_file_only -- only accept cursors located in the main file.
+        skip_system_headers -- reject cursors located in system headers.
+        files -- iterable of file names (str or PathLike), None for any file.
+        max_depth -- limit the walk depth, 1 for direct children only.
+        prune -- do not descend into cursors rejected by location filters.
+        recurse_into_matches -- keep visiting the children of a match.
+        """
+        q = _C.CursorQuery()
+        if kinds is not None:
+            q.kinds = list(kinds)
+        if spelling is not None:
+            q.spelling_regex = spelling
+        q.main_file_only = main_file_only
+        q.skip_system_headers = skip_system_headers
+        if files is not None:
+            q.files = [fspath(f) for f in files]
+        q.max_depth = max_depth
+        q.prune = prune
+        q.recurse_into_matches = recurse_into_matches
+
+        matches = conf.lib.query_cursors(self, q)
+        for cursor in matches:
+            cursor._tu = self._tu
+        return matches
+
+    def export_columns(self, with_usr=True, with_spelling=True):
+        """Export this cursor and its descendants as a columnar table.
+
+        Returns a `_C.AstColumns` in preorder (entry 0 is this cursor) whose
+        int32 columns kind, parent, depth, file, line, column, offset,
+        end_offset, usr and spelling support the buffer protocol, e.g.
+        `numpy.asarray(cols.kind)` is a zero-copy view. file/usr/spelling are
+        ids into cols.files/cols.usrs/cols.spellings, file is -1 when the node
+        has no file. No Cursor objects are created.
+        """
+        return conf.lib.export_ast_columns(self, with_usr, with_spelling)
+
+    def dump(
+            self,
+            out,
+            format="ndjson",
+            with_type=True,
+            with_usr=True,
+            main_file_only=False,
+            max_depth=-1,
+    ):
+        """Stream this cursor and its descendants to `out`.
+
+        out is a file descriptor or a binary file object with fileno(), which
+        is flushed first. format is "ndjson" or "msgpack". Every node is one
+        record with id, parent, kind, spelling, type, file, line, column,
+        offset, end_line, end_column, end_offset and usr. Nodes are written
+        natively while visiting, memory use does not depend on the tree size.
+        Returns the number of nodes written.
+        """
+        if not isinstance(out, int):
+            out.flush()
+            out = out.fileno()
+        formats = {"ndjson": _C.DUMP_NDJSON, "msgpack": _C.DUMP_MSGPACK}
+        return conf.lib.dump_ast(
+            self, out, formats[format], with_type, with_usr, main_file_only,
+            max_depth
+        )
 
     def get_tokens(self):
         """Obtain Token instances formulating that compose this Cursor.
@@ -1123,6 +1296,13 @@ class Cursor:
         """
         return TokenGroup.get_tokens(self._tu, self.extent)
 
+    def get_tokens_packed(self):
+        """Obtain the tokens of this Cursor as a `_C.PackedTokens`.
+
+        See TranslationUnit.get_tokens_packed.
+        """
+        return conf.lib.tokenize_packed(self._tu, self.extent)
+
     def get_field_offsetof(self):
         """Returns the offsetof the FIELD_DECL pointed by this Cursor."""
         return conf.lib.clang_Cursor_getOffsetOfField(self)
@@ -1162,8 +1342,8 @@ class Cursor:
                 tu = arg
                 break
 
-            if hasattr(arg, "translation_unit"):
-                tu = arg.translation_unit
+            tu = getattr(arg, "translation_unit", None)
+            if tu is not None:
                 break
 
         assert tu is not None
@@ -1184,13 +1364,73 @@ class Cursor:
 StorageClass = _C.CX_StorageClass
 AvailabilityKind = _C.CXAvailabilityKind
 AccessSpecifier = _C.CX_CXXAccessSpecifier
-TypeKind = _C.CXTypeKind
 RefQualifierKind = _C.CXRefQualifierKind
 LinkageKind = _C.CXLinkageKind
 TLSKind = _C.CXTLSKind
 
 
+@_enhance(_C.CXTypeKind)
+class TypeKind:
+    """
+    Describes the kind of type.
+
+    Like CursorKind, the predicates and the spelling come from tables built
+    into the binding, see _C.type_kind_flags() and _C.classify_type_kinds()
+    for the vectorized forms.
+    """
+
+    @property
+    def spelling(self):
+        """Retrieve the spelling of this TypeKind."""
+        return _C.type_kind_spelling(self)
+
+    def is_builtin(self):
+        """Test if this is a builtin type kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_BUILTIN)
+
+    def is_integer(self):
+        """Test if this is a builtin integer kind, bool excluded."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_INTEGER)
+
+    def is_signed_integer(self):
+        """Test if this is a builtin signed integer kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_SIGNED_INTEGER)
+
+    def is_unsigned_integer(self):
+        """Test if this is a builtin unsigned integer kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_UNSIGNED_INTEGER)
+
+    def is_floating_point(self):
+        """Test if this is a builtin floating point kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_FLOATING)
+
+    def is_pointer(self):
+        """Test if this is a pointer, block pointer or member pointer kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_POINTER)
+
+    def is_reference(self):
+        """Test if this is an lvalue or rvalue reference kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_REFERENCE)
+
+    def is_array(self):
+        """Test if this is an array kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_ARRAY)
+
+    def is_vector(self):
+        """Test if this is a vector kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_VECTOR)
+
+    def is_function(self):
+        """Test if this is a function type kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_FUNCTION)
+
+    def is_sugar(self):
+        """Test if this is a typedef, elaborated or attributed type kind."""
+        return _C.type_kind_is(self, _C.TYPE_KIND_SUGAR)
+
+
 @_enhance(_C.CXType)
+@_sync_only_methods
 class Type:
     """
     The type of an element in the abstract syntax tree.
@@ -1267,8 +1507,7 @@ class Type:
     @property
     def translation_unit(self):
         """The TranslationUnit to which this Type is associated."""
-        # If this triggers an AttributeError, the instance was not properly
-        # instantiated.
+        # None if the instance was not properly instantiated.
         return self._tu
 
     @staticmethod
@@ -1277,8 +1516,8 @@ class Type:
 
         tu = None
         for arg in args:
-            if hasattr(arg, "translation_unit"):
-                tu = arg.translation_unit
+            tu = getattr(arg, "translation_unit", None)
+            if tu is not None:
                 break
 
         assert tu is not None
@@ -1461,6 +1700,29 @@ class _CXUnsavedFile:
     """Helper for passing unsaved file arguments."""
 
 
+@_enhance(_C.UnsavedFileSet)
+class UnsavedFileSet:
+    """Unsaved files kept across calls, e.g. the open buffers of an editor.
+
+    Pass the set as unsaved_files to Index.parse, TranslationUnit.reparse and
+    TranslationUnit.codeComplete. Contents set from bytes, bytearray,
+    memoryview or mmap objects are pinned and read by libclang in place, so
+    changing one file with set() copies nothing and leaves the others as
+    they are. A str is stored as its UTF-8 encoding.
+    """
+
+    def update(self, unsaved_files):
+        """Set every (filename, contents) pair, contents may also be a file
+        object, which is read until EOF."""
+        for name, contents in unsaved_files:
+            if hasattr(contents, "read"):
+                contents = contents.read()
+            self.set(fspath(name), contents)
+
+    def items(self):
+        return [(name, self.get(name)) for name in self.names()]
+
+
 class CompletionChunk(object):
 
     def __init__(self, completionString, key):
@@ -1565,14 +1827,34 @@ class CCRStructure:
         return self.at(key)
 
 
-class CodeCompletionResults(ClangObject):
+class CodeCompletionResults(object):
+
+    def __init__(self, ptr):
+        assert isinstance(ptr, _C.CXCodeCompleteResults)
+        self.ptr = ptr
 
     def __del__(self):
-        conf.lib.clang_disposeCodeCompleteResults(self)
+        conf.lib.clang_disposeCodeCompleteResults(self.ptr)
 
     @property
     def results(self):
-        return self.ptr.contents
+        return self.ptr
+
+    def rank(self, prefix="", limit=None):
+        """Filter and rank the results natively.
+
+        The results are sorted with clang_sortCodeCompletionResults, fuzzy
+        matched against the typed `prefix` and the best `limit` (all when None)
+        are returned, best first, as tuples
+
+            (typed_text, display, result_type, priority, availability,
+             cursor_kind, index)
+
+        `index` refers to the sorted `results`, for looking up the full
+        CompletionString of an entry. Completion strings are only decoded for
+        the entries returned, which keeps large member completions cheap.
+        """
+        return _C.rank_code_completions(self.ptr, prefix, limit or 0)
 
     @property
     def diagnostics(self):
@@ -1581,10 +1863,10 @@ class CodeCompletionResults(ClangObject):
                 self.ccr = ccr
 
             def __len__(self):
-                return int(conf.lib.clang_codeCompleteGetNumDiagnostics(self.ccr))
+                return int(conf.lib.clang_codeCompleteGetNumDiagnostics(self.ccr.ptr))
 
             def __getitem__(self, key):
-                return conf.lib.clang_codeCompleteGetDiagnostic(self.ccr, key)
+                return conf.lib.clang_codeCompleteGetDiagnostic(self.ccr.ptr, key)
 
         return DiagnosticsItr(self)
 
@@ -1627,7 +1909,283 @@ class Index(ClangObject):
         """
         return TranslationUnit.from_source(path, args, unsaved_files, options, self)
 
+    async def parse_async(self, path, args=None, unsaved_files=None, options=None):
+        """Parse like parse() without blocking the asyncio event loop.
+
+        The parse runs on a native thread without the GIL. A CXIndex is never
+        used by two threads at once, so parses sharing this Index run one at
+        a time. Use several indexes to parse in parallel.
+        """
+        if options is None:
+            options = _C.clang_defaultEditingTranslationUnitOptions()
+        filename = fspath(path) if path is not None else None
+        args = list(args or [])
+        unsaved = _unsaved_pairs(unsaved_files)
+
+        def convert(ptr, err):
+            if not ptr:
+                raise TranslationUnitLoadError(
+                    "Error parsing translation unit (CXErrorCode %d)." % err
+                )
+            return TranslationUnit(ptr, index=self)
+
+        return await _run_async(
+            lambda done: _async_pool().parse(
+                self, filename, args, unsaved, options, done
+            ),
+            convert,
+        )
+
+    def index_file(
+            self,
+            path,
+            args=None,
+            unsaved_files=None,
+            index_options=0,
+            options=None,
+            with_references=True,
+    ):
+        """Run the libclang indexer over a source file.
+
+        path, args, unsaved_files and options are as for Index.parse. A
+        CompileCommand may be passed as path, its arguments are then used as a
+        full command line. index_options is a bitwise or of _C.CXIndexOptFlags.
+
+        Declarations and, with with_references, entity references are
+        collected natively into a `_C.IndexRecords` without any per-event
+        Python calls. Its int32 columns is_reference, entity_kind, usr, name,
+        file, line, column, offset, container, role and flags support the
+        buffer protocol, usr/name/container index into records.usrs/names and
+        file into records.files. role holds _C.CXSymbolRole bits and flags
+        _C.INDEX_RECORD_* bits.
+
+        Raises TranslationUnitLoadError if the file could not be parsed.
+        """
+        filename, args, full_argv, unsaved_array, options = _index_arguments(
+            path, args, unsaved_files, options
+        )
+        records, err = _C.index_source_file(
+            self, filename, args, full_argv, unsaved_array, index_options,
+            options, with_references
+        )
+        if err != 0:
+            raise TranslationUnitLoadError(
+                "Error indexing translation unit (error %d)." % err
+            )
+        return records
+
+    def index_session(self, index_options=None, with_references=True):
+        """Create an IndexSession indexing files with one shared action.
+
+        index_options defaults to CXIndexOpt_SkipParsedBodiesInSession.
+        """
+        return IndexSession(self, index_options, with_references)
+
+    def parse_many(self, commands, workers=None, options=None, max_in_flight=None):
+        """Parse many translation units in parallel on native threads.
+
+        commands is an iterable of CompileCommand objects (e.g. from
+        CompilationDatabase.getAllCompileCommands()) or of (filename, args)
+        pairs, where args are passed the same way as in Index.parse.
+
+        Each worker owns its own Index. At most max_in_flight commands
+        (2 * workers by default) are queued or parsed but not yet yielded, so
+        commands are consumed lazily.
+
+        Yields (command, result) pairs in completion order, where result is
+        either a TranslationUnit or a TranslationUnitLoadError.
+        """
+        if workers is None:
+            workers = os.cpu_count() or 1
+        if max_in_flight is None:
+            max_in_flight = 2 * workers
+        assert workers > 0 and max_in_flight > 0
+        if options is None:
+            options = _C.clang_defaultEditingTranslationUnitOptions()
+
+        indexes = [Index.create() for _ in range(workers)]
+        pool = _C.ParsePool(indexes)
+        submitted = {}
+        job_ids = itertools.count()
+        commands = iter(commands)
+        try:
+            while True:
+                while len(submitted) < max_in_flight:
+                    cmd = next(commands, None)
+                    if cmd is None:
+                        break
+                    job_id = next(job_ids)
+                    submitted[job_id] = cmd
+                    if isinstance(cmd, CompileCommand):
+                        args = list(cmd.arguments)
+                        args.insert(1, "-working-directory=" + cmd.directory)
+                        pool.submit(job_id, "", args, True, options)
+                    else:
+                        filename, args = cmd
+                        pool.submit(job_id, fspath(filename), list(args or []), False, options)
+                done = pool.next()
+                if done is None:
+                    return
+                job_id, worker, ptr, err = done
+                cmd = submitted.pop(job_id)
+                if ptr:
+                    yield cmd, TranslationUnit(ptr, index=indexes[worker])
+                else:
+                    yield cmd, TranslationUnitLoadError(
+                        "Error parsing translation unit (CXErrorCode %d)." % err
+                    )
+        finally:
+            # Disposes any unconsumed TU before the indexes may go away.
+            pool.shutdown()
+
+
+def _index_arguments(path, args, unsaved_files, options):
+    """(filename, args, full_argv, unsaved files, options) for the indexer."""
+    if options is None:
+        options = _C.clang_defaultEditingTranslationUnitOptions()
+    unsaved_array = []
+    if unsaved_files is not None:
+        unsaved_array = TranslationUnit._to_cx_unsaved_file(unsaved_files)
+
+    if isinstance(path, CompileCommand):
+        args = list(path.arguments)
+        args.insert(1, "-working-directory=" + path.directory)
+        return "", args, True, unsaved_array, options
+    filename = fspath(path) if path is not None else ""
+    return filename, list(args or []), False, unsaved_array, options
+
+
+def _unsaved_pairs(unsaved_files):
+    """unsaved_files as (filename, contents) pairs copied by native code."""
+    if isinstance(unsaved_files, UnsavedFileSet):
+        unsaved_files = unsaved_files.items()
+    files = []
+    for name, contents in unsaved_files or []:
+        if hasattr(contents, "read"):
+            contents = contents.read()
+        if not isinstance(contents, (str, bytes)):
+            contents = bytes(contents)
+        files.append((fspath(name), contents))
+    return files
+
+
+_async_executor = None
+
+
+def _async_pool():
+    """The AsyncPool shared by the *_async methods, created on first use."""
+    global _async_executor
+    if _async_executor is None:
+        _async_executor = _C.AsyncPool(os.cpu_count() or 1)
+        atexit.register(_async_executor.shutdown)
+    return _async_executor
+
+
+async def _run_async(submit, convert):
+    """Await a native call started by submit(done).
+
+    The pool calls done(*result) on its worker thread, which converts the
+    result right away, so a result nobody waits for anymore is still wrapped
+    and disposed, and hands it to the loop with call_soon_threadsafe.
+    """
+    loop = asyncio.get_running_loop()
+    future = loop.create_future()
+
+    def settle(value, error):
+        if future.cancelled():
+            return
+        if error is not None:
+            future.set_exception(error)
+        else:
+            future.set_result(value)
+
+    def done(*result):
+        try:
+            value, error = convert(*result), None
+        except Exception as e:
+            value, error = None, e
+        try:
+            loop.call_soon_threadsafe(settle, value, error)
+        except RuntimeError:
+            pass  # The loop is closed.
+
+    submit(done)
+    return await future
+
+
+class IndexSession(object):
+    """Indexes a batch of files with one shared CXIndexAction.
+
+    With CXIndexOpt_SkipParsedBodiesInSession, libclang skips function bodies
+    in headers an earlier file of the session already parsed. On top of that,
+    declarations and references located in a header that was indexed for an
+    earlier file are dropped natively, so each header's entities are emitted
+    once per session. The main file of each call is always indexed in full.
+
+    Files are indexed one at a time without holding the GIL. Threads sharing
+    a session wait for each other, use one session per thread to index in
+    parallel.
+    """
+
+    def __init__(self, index, index_options=None, with_references=True):
+        if index_options is None:
+            index_options = int(
+                _C.CXIndexOptFlags.CXIndexOpt_SkipParsedBodiesInSession
+            )
+        self.index = index
+        self._session = _C.IndexSession(index, index_options, with_references)
 
+    def index_file(self, path, args=None, unsaved_files=None, options=None):
+        """Index one file, arguments are as for Index.index_file.
+
+        Returns a `_C.IndexRecords` holding the entities not emitted earlier
+        in the session. Raises TranslationUnitLoadError on failure.
+        """
+        filename, args, full_argv, unsaved_array, options = _index_arguments(
+            path, args, unsaved_files, options
+        )
+        records, err = self._session.index_source_file(
+            filename, args, full_argv, unsaved_array, options
+        )
+        if err != 0:
+            raise TranslationUnitLoadError(
+                "Error indexing translation unit (error %d)." % err
+            )
+        return records
+
+    def index_many(self, commands, options=None):
+        """Index CompileCommand objects or (filename, args) pairs in order.
+
+        Yields (command, result) pairs, where result is either IndexRecords
+        or a TranslationUnitLoadError.
+        """
+        for cmd in commands:
+            if isinstance(cmd, CompileCommand):
+                path, args = cmd, None
+            else:
+                path, args = cmd
+            try:
+                yield cmd, self.index_file(path, args, options=options)
+            except TranslationUnitLoadError as e:
+                yield cmd, e
+
+    def stats(self):
+        """Throughput and deduplication counters of the session."""
+        s = self._session
+        return {
+            "files": s.files,
+            "errors": s.errors,
+            "seen_files": s.seen_files,
+            "records": s.records,
+            "duplicates": s.duplicates,
+            "skipped_files": s.skipped_files,
+            "seconds": s.seconds,
+            "files_per_second": s.files / s.seconds if s.seconds else 0.0,
+            "records_per_second": s.records / s.seconds if s.seconds else 0.0,
+        }
+
+
+@_sync_only_methods
 class TranslationUnit(_C.CXTranslationUnitImplp):
     """Represents a source code translation unit.
 
@@ -1667,12 +2225,23 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
     # into the set of code completions returned from this translation unit.
     PARSE_INCLUDE_BRIEF_COMMENTS_IN_CODE_COMPLETION = 128
 
+    # Used with PARSE_PRECOMPILED_PREAMBLE to build the preamble on the
+    # initial parse instead of on the first reparse.
+    PARSE_CREATE_PREAMBLE_ON_FIRST_PARSE = 256
+
     @staticmethod
     def _to_cx_unsaved_file(unsaved_files):
+        if isinstance(unsaved_files, UnsavedFileSet):
+            unsaved_files = unsaved_files.items()
         unsaved_array = []
         for i, (name, contents) in enumerate(unsaved_files):
             if hasattr(contents, "read"):
                 contents = contents.read()
+            if isinstance(contents, str):
+                # Length is in bytes.
+                contents = contents.encode()
+            elif not isinstance(contents, bytes):
+                contents = bytes(contents)
             f = _CXUnsavedFile()
             name = _C.StringHolder(fspath(name))
             content = _C.StringHolder(contents)
@@ -1684,6 +2253,17 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
             unsaved_array.append(f)
         return unsaved_array
 
+    @staticmethod
+    def _to_unsaved_file_set(unsaved_files):
+        """unsaved_files as an UnsavedFileSet, pinning buffers instead of
+        copying them."""
+        if isinstance(unsaved_files, UnsavedFileSet):
+            return unsaved_files
+        unsaved_set = UnsavedFileSet()
+        if unsaved_files is not None:
+            unsaved_set.update(unsaved_files)
+        return unsaved_set
+
     @classmethod
     def from_source(
             cls, filename, args=None, unsaved_files=None, options=None, index=None
@@ -1700,9 +2280,12 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
         In-memory file content can be provided via unsaved_files. This is an
         iterable of 2-tuples. The first element is the filename (str or
         PathLike). The second element defines the content. Content can be
-        provided as str source code or as file objects (anything with a read()
-        method). If a file object is being used, content will be read until EOF
-        and the read cursor will not be reset to its original position.
+        provided as str source code, as bytes-like objects (bytes, memoryview,
+        mmap, which are read in place without copying) or as file objects
+        (anything with a read() method). If a file object is being used,
+        content will be read until EOF and the read cursor will not be reset
+        to its original position. An UnsavedFileSet can be passed instead to
+        reuse the same files across parses.
 
         options is a bitwise or of TranslationUnit.PARSE_XXX flags which will
         control parsing behavior.
@@ -1731,9 +2314,7 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
         if index is None:
             index = Index.create()
 
-        unsaved_array = []
-        if unsaved_files is not None:
-            unsaved_array = cls._to_cx_unsaved_file(unsaved_files)
+        unsaved_set = cls._to_unsaved_file_set(unsaved_files)
 
         if options is None:
             options = _C.clang_defaultEditingTranslationUnitOptions()
@@ -1742,7 +2323,7 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
             index,
             fspath(filename) if filename is not None else None,
             args,
-            unsaved_array,
+            unsaved_set,
             options,
         )
 
@@ -1769,9 +2350,11 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
         if index is None:
             index = Index.create()
 
-        ptr = conf.lib.clang_createTranslationUnit(index, fspath(filename))
+        ptr, err = _C.create_translation_unit(index, fspath(filename))
         if not ptr:
-            raise TranslationUnitLoadError(filename)
+            raise TranslationUnitLoadError(
+                "Error loading AST file %s (%s)" % (fspath(filename), err)
+            )
 
         return cls(ptr=ptr, index=index)
 
@@ -1786,9 +2369,54 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
         assert isinstance(index, Index)
         self.index = index
 
+    # Capacity of the per-TU cache of decoded source locations.
+    LOCATION_CACHE_CAPACITY = 65536
+
     def __del__(self):
+        # Also drops the string intern table.
         conf.lib.clang_disposeTranslationUnit(self)
 
+    def enable_string_interning(self, enabled=True, capacity=65536):
+        """Deduplicate strings (spellings, USRs, ...) returned for this TU.
+
+        While enabled, equal strings returned for cursors, tokens and files
+        of this TU are the same Python object. At most `capacity` distinct strings
+        are kept, later ones are returned without being interned. The table
+        is dropped with the TU or when disabled.
+        """
+        _C.set_string_interning(self, enabled, capacity)
+
+    @property
+    def location_decoder(self):
+        """The `_C.LocationDecoder` caching decoded locations of this TU."""
+        if not hasattr(self, "_location_decoder"):
+            self._location_decoder = _C.LocationDecoder(self.LOCATION_CACHE_CAPACITY)
+            self._location_files = []
+        return self._location_decoder
+
+    def _location_file(self, file_id):
+        if file_id < 0:
+            return None
+        files = self._location_files
+        if len(files) <= file_id:
+            files.extend([None] * (file_id + 1 - len(files)))
+        if files[file_id] is None:
+            files[file_id] = File._of(self, self._location_decoder.file(file_id))
+        return files[file_id]
+
+    def decode_locations(self, locations):
+        """Decode SourceLocations of this TU in one native call.
+
+        Returns a list of (File, line, column, offset) tuples. Results are
+        cached in a bounded LRU owned by this TU, File objects are shared
+        between locations of the same file.
+        """
+        decoder = self.location_decoder
+        return [
+            (self._location_file(f), l, c, o)
+            for f, l, c, o in decoder.decode_locations(list(locations))
+        ]
+
     @property
     def cursor(self):
         """Retrieve the cursor that represents the given translation unit."""
@@ -1810,9 +2438,12 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
         """
         includes = []
 
-        def visitor(fobj, loc, depth, data):
+        def visitor(fobj, stack, depth, data):
             if depth > 0:
-                includes.append(FileInclusion(loc.file, File(fobj), loc, depth))
+                loc = stack[0]
+                includes.append(
+                    FileInclusion(loc.file, File._of(self, fobj), loc, depth)
+                )
 
         # Automatically adapt CIndex/ctype pointers to python objects
 
@@ -1905,6 +2536,84 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
 
         return DiagIterator(self)
 
+    def diagnostics_packed(self):
+        """Return every diagnostic as a `_C.PackedDiagnostics`, in one call.
+
+        Diagnostics are rows of int32 columns (severity, category, option,
+        message, parent, file, line, column, offset) in the order libclang
+        reports them, with child notes right after their parent and parent
+        set to its row (-1 for top-level ones). Source ranges and fix-its are
+        rows of the span_* columns, linked back by span_diagnostic; fix-its
+        have span_is_fixit set and their replacement in span_text. Strings
+        are ids into `strings`, files ids into `files` (-1 for none). Every
+        column supports the buffer protocol.
+        """
+        return _C.export_diagnostics(self)
+
+    def index_symbols(self, index_options=0, with_references=True):
+        """Run the libclang indexer over this translation unit.
+
+        Returns a `_C.IndexRecords`, see Index.index_file.
+        """
+        records, err = _C.index_translation_unit(
+            self.index, self, index_options, with_references
+        )
+        if err != 0:
+            raise TranslationUnitLoadError(
+                "Error indexing translation unit (error %d)." % err
+            )
+        return records
+
+    def resource_usage(self):
+        """Return the memory used by this translation unit as {name: bytes}."""
+        return _C.tu_resource_usage(self)
+
+    @property
+    def memory_usage(self):
+        """Total bytes reported by clang_getCXTUResourceUsage."""
+        return sum(self.resource_usage().values())
+
+    # Asynchronous calls submitted on this translation unit and not yet
+    # finished, see reparse_async().
+    _async_pending = 0
+
+    def _check_no_async(self):
+        if self._async_pending:
+            raise RuntimeError(
+                "translation unit is busy with %d asynchronous call(s), "
+                "await them first" % self._async_pending
+            )
+
+    async def _run_async(self, submit, convert):
+        """_run_async() counting the call in _async_pending until it ends."""
+
+        def count(n):
+            global _async_calls
+            self._async_pending += n
+            _async_calls += n
+
+        def counted_submit(done):
+            count(1)
+            try:
+                submit(done)
+            except BaseException:
+                count(-1)
+                raise
+
+        def counted_convert(*result):
+            count(-1)
+            return convert(*result)
+
+        return await _run_async(counted_submit, counted_convert)
+
+    def suspend(self):
+        """Free most of the memory held by this translation unit.
+
+        A suspended translation unit must be reparsed before any other use.
+        Returns True on success.
+        """
+        return bool(_C.clang_suspendTranslationUnit(self))
+
     def reparse(self, unsaved_files=None, options=None):
         """
         Reparse an already parsed translation unit.
@@ -1912,19 +2621,47 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
         In-memory contents for files can be provided by passing a list of pairs
         as unsaved_files, the first items should be the filenames to be mapped
         and the second should be the contents to be substituted for the
-        file. The contents may be passed as strings or file objects.
+        file. The contents may be passed as strings, bytes-like objects or
+        file objects, or the whole argument as an UnsavedFileSet.
+
+        If libclang fails, a TranslationUnitLoadError is raised. The
+        translation unit is invalid afterwards and should be dropped.
         """
-        unsaved_files_array = []
-        if unsaved_files is not None:
-            unsaved_files_array = self._to_cx_unsaved_file(unsaved_files)
+        unsaved_set = self._to_unsaved_file_set(unsaved_files)
 
         if options is None:
             options = _C.clang_defaultReparseOptions(self)
 
-        err = conf.lib.clang_reparseTranslationUnit(
-            self, unsaved_files_array, options
+        err = conf.lib.clang_reparseTranslationUnit(self, unsaved_set, options)
+        if err != 0:
+            raise TranslationUnitLoadError(
+                "Error reparsing translation unit (error %d)." % err
+            )
+
+    async def reparse_async(self, unsaved_files=None, options=None):
+        """Reparse like reparse() without blocking the asyncio event loop.
+
+        Asynchronous calls on one translation unit run one at a time in the
+        order they were made. Until all of them are done, the public methods
+        and properties of the translation unit and of its Cursor, Type,
+        Token, File, SourceLocation and SourceRange objects raise
+        RuntimeError. Diagnostic objects are not tracked, do not use them
+        either.
+        """
+        unsaved = _unsaved_pairs(unsaved_files)
+        if options is None:
+            options = _C.clang_defaultReparseOptions(self)
+
+        def convert(err):
+            if err != 0:
+                raise TranslationUnitLoadError(
+                    "Error reparsing translation unit (error %d)." % err
+                )
+
+        await self._run_async(
+            lambda done: _async_pool().reparse(self, unsaved, options, done),
+            convert,
         )
-        assert err == 0
 
     def save(self, filename):
         """Saves the TranslationUnit to a file.
@@ -1964,7 +2701,8 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
         In-memory contents for files can be provided by passing a list of pairs
         as unsaved_files, the first items should be the filenames to be mapped
         and the second should be the contents to be substituted for the
-        file. The contents may be passed as strings or file objects.
+        file. The contents may be passed as strings, bytes-like objects or
+        file objects, or the whole argument as an UnsavedFileSet.
         """
         options = 0
 
@@ -1977,23 +2715,55 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
         if include_brief_comments:
             options += 4
 
-        unsaved_files_array = []
-        if unsaved_files is not None:
-            unsaved_files_array = self._to_cx_unsaved_file(unsaved_files)
+        unsaved_set = self._to_unsaved_file_set(unsaved_files)
 
         ptr = conf.lib.clang_codeCompleteAt(
             self,
             fspath(path),
             line,
             column,
-            unsaved_files_array,
-            len(unsaved_files),
+            unsaved_set,
             options,
         )
         if ptr:
             return CodeCompletionResults(ptr)
         return None
 
+    async def code_complete_async(
+            self,
+            path,
+            line,
+            column,
+            unsaved_files=None,
+            include_macros=False,
+            include_code_patterns=False,
+            include_brief_comments=False,
+    ):
+        """codeComplete() without blocking the asyncio event loop.
+
+        Runs after the asynchronous calls already made on this translation
+        unit, see reparse_async().
+        """
+        options = 0
+        if include_macros:
+            options += 1
+        if include_code_patterns:
+            options += 2
+        if include_brief_comments:
+            options += 4
+        filename = fspath(path)
+        unsaved = _unsaved_pairs(unsaved_files)
+
+        def convert(ptr):
+            return CodeCompletionResults(ptr) if ptr else None
+
+        return await self._run_async(
+            lambda done: _async_pool().code_complete(
+                self, filename, line, column, unsaved, options, done
+            ),
+            convert,
+        )
+
     def get_tokens(self, locations=None, extent=None):
         """Obtain tokens in this translation unit.
 
@@ -2007,7 +2777,566 @@ class TranslationUnit(_C.CXTranslationUnitImplp):
 
         return TokenGroup.get_tokens(self, extent)
 
+    def get_tokens_packed(self, locations=None, extent=None):
+        """Obtain tokens in this translation unit as packed columns.
+
+        Takes the same range arguments as get_tokens, but tokenizes in a single
+        native call and returns a `_C.PackedTokens`. Its int32 columns kind,
+        offset, end_offset, line and column support the buffer protocol,
+        `spelling(i)` / `spellings` give the token text. No Token objects are
+        created and no CXToken memory is kept alive.
+        """
+        if locations is not None:
+            extent = SourceRange(start=locations[0], end=locations[1])
+
+        return conf.lib.tokenize_packed(self, extent)
+
+    def annotate_tokens(self, locations=None, extent=None):
+        """Return the Cursor of every token in a range.
+
+        Takes the same range arguments as get_tokens. The range is tokenized
+        and annotated by a single clang_annotateTokens call.
+        """
+        if locations is not None:
+            extent = SourceRange(start=locations[0], end=locations[1])
+
+        cursors = conf.lib.annotate_tokens(self, extent)
+        for cursor in cursors:
+            cursor._tu = self
+        return cursors
+
+    def annotate_tokens_packed(self, locations=None, extent=None, with_usr=True):
+        """Tokenize and annotate a range without creating Python objects.
+
+        Returns a `_C.AnnotatedTokens`: `tokens` is the `_C.PackedTokens` of
+        the range (see get_tokens_packed), `cursor_kind` holds the kind of the
+        cursor annotating each token and `usr` the id in `usrs` of the entity
+        that cursor references, 0 ("") if it references nothing.
+        """
+        if locations is not None:
+            extent = SourceRange(start=locations[0], end=locations[1])
+
+        return conf.lib.annotate_tokens_packed(self, extent, with_usr)
+
+
+class TranslationUnitPool(object):
+    """Keeps parsed translation units alive, keyed by (filename, args).
+
+    The first request for a key parses it with a precompiled preamble built on
+    that first parse. Later edits reparse the resident translation unit, which
+    reuses the preamble. Entries are kept in LRU order. When the total
+    clang_getCXTUResourceUsage of the pool exceeds `memory_budget` bytes, the
+    least recently used entries are suspended first and evicted once
+    suspending no longer helps. `max_entries` bounds the number of resident
+    entries.
+
+    A translation unit returned by the pool stays valid until the next call
+    into the pool, which may suspend it. Ask the pool again instead of keeping
+    it around.
 
+    The unsaved files last given for an entry are kept with it and used
+    again whenever it is reparsed without new ones, e.g. when resuming a
+    suspended entry. Pass an empty list to go back to the files on disk.
+    """
+
+    DEFAULT_OPTIONS = (
+        TranslationUnit.PARSE_PRECOMPILED_PREAMBLE
+        | TranslationUnit.PARSE_CREATE_PREAMBLE_ON_FIRST_PARSE
+    )
+
+    class _Entry(object):
+        __slots__ = ("tu", "suspended", "memory", "unsaved_files")
+
+        def __init__(self, tu, unsaved_files):
+            self.tu = tu
+            self.suspended = False
+            self.memory = tu.memory_usage
+            self.unsaved_files = unsaved_files
+
+    def __init__(
+            self,
+            index=None,
+            options=None,
+            memory_budget=None,
+            max_entries=None,
+            suspend=True,
+    ):
+        if index is None:
+            index = Index.create()
+        if options is None:
+            options = (
+                    _C.clang_defaultEditingTranslationUnitOptions()
+                    | self.DEFAULT_OPTIONS
+            )
+        self.index = index
+        self.options = options
+        self.memory_budget = memory_budget
+        self.max_entries = max_entries
+        self.suspend_before_evict = suspend
+        # dicts keep insertion order, the first entry is the least recently
+        # used one.
+        self._entries = {}
+        self.parses = 0
+        self.reparses = 0
+        self.hits = 0
+        self.suspensions = 0
+        self.evictions = 0
+
+    @staticmethod
+    def _key(filename, args):
+        return fspath(filename), tuple(args or ())
+
+    def __len__(self):
+        return len(self._entries)
+
+    def __contains__(self, key):
+        return self._key(*key) in self._entries
+
+    def get(self, filename, args=None, unsaved_files=None):
+        """Return the translation unit of (filename, args).
+
+        It is parsed if not resident, and reparsed if unsaved_files are given
+        or it was suspended. A failed reparse drops the entry and raises
+        TranslationUnitLoadError.
+        """
+        key = self._key(filename, args)
+        entry = self._entries.pop(key, None)
+        if entry is None:
+            unsaved_set = TranslationUnit._to_unsaved_file_set(unsaved_files)
+            tu = TranslationUnit.from_source(
+                key[0], list(key[1]), unsaved_set, self.options, self.index
+            )
+            entry = self._Entry(tu, unsaved_set)
+            self.parses += 1
+        elif unsaved_files is not None or entry.suspended:
+            # Not resident while reparsing, a failure leaves it dropped.
+            self._reparse(entry, unsaved_files)
+        else:
+            self.hits += 1
+        self._entries[key] = entry
+        self._enforce_budget()
+        return entry.tu
+
+    def update(self, filename, args=None, unsaved_files=None):
+        """Reparse (filename, args), e.g. after it changed on disk."""
+        key = self._key(filename, args)
+        entry = self._entries.get(key)
+        if entry is None:
+            return self.get(filename, args, unsaved_files)
+        del self._entries[key]
+        self._reparse(entry, unsaved_files)
+        self._entries[key] = entry
+        self._enforce_budget()
+        return entry.tu
+
+    def evict(self, filename, args=None):
+        """Drop (filename, args) from the pool, returns whether it was resident."""
+        return self._entries.pop(self._key(filename, args), None) is not None
+
+    def clear(self):
+        self._entries.clear()
+
+    @property
+    def memory_usage(self):
+        """Bytes used by the resident translation units, as last measured."""
+        return sum(e.memory for e in self._entries.values())
+
+    def stats(self):
+        return {
+            "entries": len(self._entries),
+            "suspended": sum(1 for e in self._entries.values() if e.suspended),
+            "memory_usage": self.memory_usage,
+            "parses": self.parses,
+            "reparses": self.reparses,
+            "hits": self.hits,
+            "suspensions": self.suspensions,
+            "evictions": self.evictions,
+        }
+
+    def _reparse(self, entry, unsaved_files):
+        if unsaved_files is not None:
+            entry.unsaved_files = TranslationUnit._to_unsaved_file_set(
+                unsaved_files
+            )
+        # On failure the caller has already taken the entry out of the pool,
+        # its translation unit is disposed with the last reference.
+        entry.tu.reparse(entry.unsaved_files)
+        entry.suspended = False
+        entry.memory = entry.tu.memory_usage
+        self.reparses += 1
+
+    def _enforce_budget(self):
+        # Never touch the most recently used entry, it was just handed out.
+        if self.max_entries is not None:
+            while len(self._entries) > max(self.max_entries, 1):
+                self._evict_oldest()
+
+        if self.memory_budget is None:
+            return
+        if self.suspend_before_evict:
+            for entry in list(self._entries.values())[:-1]:
+                if self.memory_usage <= self.memory_budget:
+                    return
+                if not entry.suspended and entry.tu.suspend():
+                    entry.suspended = True
+                    entry.memory = entry.tu.memory_usage
+                    self.suspensions += 1
+        while len(self._entries) > 1 and self.memory_usage > self.memory_budget:
+            self._evict_oldest()
+
+    def _evict_oldest(self):
+        del self._entries[next(iter(self._entries))]
+        self.evictions += 1
+
+
+class CompletionService(object):
+    """Serves code completion for one translation unit from a native thread.
+
+    The translation unit is parsed with PARSE_CACHE_COMPLETION_RESULTS and
+    PARSE_PRECOMPILED_PREAMBLE by a dedicated thread, which then runs every
+    clang_codeCompleteAt. Meant to be fed on every keystroke:
+
+      * submitting a request for a file replaces the one still queued for it,
+      * a request that finishes after a newer one for its file was submitted
+        is dropped, and result() returns None for it,
+      * cancel() drops a queued or running request.
+
+    Results are ranked natively like CodeCompletionResults.rank(). stats()
+    reports request counters and p50/p90/p99 latency histograms, both from
+    submission to result ("latency") and of the completion itself
+    ("complete").
+    """
+
+    def __init__(self, path, args=None, unsaved_files=None, options=0):
+        try:
+            self._service = _C.CompletionService(
+                fspath(path),
+                [fspath(a) for a in args or []],
+                _unsaved_pairs(unsaved_files),
+                options,
+            )
+        except RuntimeError as e:
+            raise TranslationUnitLoadError(str(e))
+
+    def submit(
+            self,
+            path,
+            line,
+            column,
+            unsaved_files=None,
+            prefix="",
+            limit=None,
+            include_macros=False,
+            include_code_patterns=False,
+            include_brief_comments=False,
+    ):
+        """Queue a completion request and return its id.
+
+        `prefix` is the identifier typed so far, used to fuzzy filter the
+        results, of which the best `limit` (all when None) are kept.
+        """
+        options = 0
+        if include_macros:
+            options += 1
+        if include_code_patterns:
+            options += 2
+        if include_brief_comments:
+            options += 4
+        return self._service.submit(
+            fspath(path), line, column, _unsaved_pairs(unsaved_files),
+            options, prefix, limit or 0
+        )
+
+    def result(self, request_id, timeout=None):
+        """Wait for request `request_id` and return its ranked completions.
+
+        Items are (typed_text, display, result_type, priority, availability,
+        cursor_kind, index) tuples. Returns None if the request was coalesced,
+        superseded or cancelled. Raises TimeoutError after `timeout` seconds.
+        """
+        done = self._service.wait(request_id, -1.0 if timeout is None else timeout)
+        if done is None:
+            raise TimeoutError("completion request %d timed out" % request_id)
+        status, items, _ = done
+        if status == _C.COMPLETION_DROPPED:
+            return None
+        if status == _C.COMPLETION_FAILED:
+            raise RuntimeError("clang_codeCompleteAt failed")
+        return items
+
+    def complete(self, path, line, column, unsaved_files=None, timeout=None,
+                 **kwargs):
+        """submit() and wait for the result()."""
+        request_id = self.submit(path, line, column, unsaved_files, **kwargs)
+        return self.result(request_id, timeout)
+
+    def cancel(self, request_id):
+        """Drop a queued or running request, returns False if it finished."""
+        return self._service.cancel(request_id)
+
+    def stats(self):
+        return self._service.stats()
+
+    def close(self):
+        """Stop the service thread and dispose the translation unit."""
+        self._service.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+class AstCache(object):
+    """Persistent cache of parsed translation units in a directory.
+
+    An entry is keyed on the hash of the filename, args, parse options, main
+    file contents and unsaved files. Its manifest `<key>.json` records every
+    file included by the translation unit with its mtime, size and content
+    hash. The AST is stored as `<key>-<digest>.ast`, where digest covers the
+    contents of those includes.
+
+    A lookup is a hit when no include changed. mtime and size are checked
+    first, contents are rehashed only when they differ. Hits load the AST
+    with TranslationUnit.from_ast_file. Misses parse the source and save() it.
+    Files are written to a temporary name and renamed into place, so
+    concurrent processes never see partial entries. Once the cache exceeds
+    `max_bytes`, the least recently used entries are removed.
+    """
+
+    _FORMAT = b"pylibclang-ast-cache-1"
+
+    def __init__(self, directory, max_bytes=None, index=None):
+        if index is None:
+            index = Index.create()
+        self.directory = fspath(directory)
+        self.max_bytes = max_bytes
+        self.index = index
+        os.makedirs(self.directory, exist_ok=True)
+        self.hits = 0
+        self.misses = 0
+        self.stale = 0
+        self.stores = 0
+        self.store_errors = 0
+        self.load_errors = 0
+        self.evictions = 0
+
+    @staticmethod
+    def _read(path):
+        with open(path, "rb") as f:
+            return f.read()
+
+    @staticmethod
+    def _as_bytes(contents):
+        if isinstance(contents, str):
+            return contents.encode("utf-8")
+        try:
+            # Buffers first, an mmap has read() but is hashed whole.
+            return bytes(memoryview(contents))
+        except TypeError:
+            pass
+        contents = contents.read()
+        if isinstance(contents, str):
+            contents = contents.encode("utf-8")
+        return bytes(contents)
+
+    def _key(self, filename, args, unsaved_files, options):
+        h = hashlib.sha256(self._FORMAT)
+        unsaved = {}
+        if isinstance(unsaved_files, UnsavedFileSet):
+            # Hashed from its pinned contents, the set itself is passed on.
+            for name, contents in unsaved_files.items():
+                unsaved[name] = self._as_bytes(contents)
+        else:
+            for name, contents in unsaved_files or ():
+                unsaved[fspath(name)] = self._as_bytes(contents)
+
+        def feed(data):
+            h.update(b"%d:" % len(data))
+            h.update(data)
+
+        feed(os.fsencode(filename))
+        feed(b"%d" % options)
+        for arg in args or ():
+            feed(os.fsencode(arg))
+        feed(b"--")
+        if filename in unsaved:
+            feed(unsaved[filename])
+        else:
+            feed(self._read(filename))
+        for name in sorted(unsaved):
+            feed(os.fsencode(name))
+            feed(unsaved[name])
+        if isinstance(unsaved_files, UnsavedFileSet):
+            return h.hexdigest(), unsaved_files
+        # The unsaved contents were consumed, hand them on as bytes.
+        return h.hexdigest(), list(unsaved.items())
+
+    @staticmethod
+    def _dependencies(tu):
+        deps = {}
+        for inclusion in tu.get_includes():
+            name = inclusion.include.name
+            if name in deps:
+                continue
+            st = os.stat(name)
+            deps[name] = [
+                st.st_mtime_ns,
+                st.st_size,
+                hashlib.sha256(AstCache._read(name)).hexdigest(),
+            ]
+        return sorted([name] + v for name, v in deps.items())
+
+    @staticmethod
+    def _digest(deps):
+        h = hashlib.sha256()
+        for name, _, _, content_hash in deps:
+            h.update(os.fsencode(name) + b"\0" + content_hash.encode() + b"\0")
+        return h.hexdigest()
+
+    @staticmethod
+    def _up_to_date(deps):
+        for name, mtime_ns, size, content_hash in deps:
+            try:
+                st = os.stat(name)
+                if st.st_mtime_ns == mtime_ns and st.st_size == size:
+                    continue
+                if hashlib.sha256(AstCache._read(name)).hexdigest() != content_hash:
+                    return False
+            except OSError:
+                return False
+        return True
+
+    def _path(self, name):
+        return os.path.join(self.directory, name)
+
+    def _write_atomic(self, final, write):
+        fd, tmp = tempfile.mkstemp(dir=self.directory, suffix=".tmp")
+        os.close(fd)
+        try:
+            write(tmp)
+            os.replace(tmp, final)
+        finally:
+            if os.path.exists(tmp):
+                os.remove(tmp)
+
+    def _load_manifest(self, key):
+        try:
+            with open(self._path(key + ".json"), "r") as f:
+                return json.load(f)
+        except (OSError, ValueError):
+            return None
+
+    def get(self, filename, args=None, unsaved_files=None, options=None):
+        """Return the TranslationUnit of (filename, args, unsaved_files).
+
+        It is loaded from the cache when possible, otherwise parsed and stored.
+        Raises TranslationUnitLoadError if parsing fails.
+        """
+        filename = fspath(filename)
+        if options is None:
+            options = _C.clang_defaultEditingTranslationUnitOptions()
+        key, unsaved_files = self._key(filename, args, unsaved_files, options)
+
+        manifest = self._load_manifest(key)
+        if manifest is not None:
+            ast = self._path(manifest["ast"])
+            if self._up_to_date(manifest["deps"]) and os.path.exists(ast):
+                try:
+                    tu = TranslationUnit.from_ast_file(ast, self.index)
+                except TranslationUnitLoadError:
+                    self.load_errors += 1
+                else:
+                    os.utime(ast)
+                    self.hits += 1
+                    return tu
+            else:
+                self.stale += 1
+
+        self.misses += 1
+        tu = TranslationUnit.from_source(
+            filename, args, unsaved_files, options, self.index
+        )
+        self._store(key, manifest, tu)
+        return tu
+
+    def _store(self, key, old_manifest, tu):
+        try:
+            deps = self._dependencies(tu)
+            ast_name = "%s-%s.ast" % (key, self._digest(deps))
+            self._write_atomic(self._path(ast_name), tu.save)
+
+            def write_manifest(tmp):
+                with open(tmp, "w") as f:
+                    json.dump({"ast": ast_name, "deps": deps}, f)
+
+            self._write_atomic(self._path(key + ".json"), write_manifest)
+        except (OSError, TranslationUnitSaveError):
+            self.store_errors += 1
+            return
+        self.stores += 1
+        if old_manifest is not None and old_manifest.get("ast") != ast_name:
+            self._remove(old_manifest.get("ast"))
+        self._evict()
+
+    def _remove(self, name):
+        try:
+            os.remove(self._path(name))
+        except (OSError, TypeError):
+            pass
+
+    def _entries(self):
+        """[(mtime, size, ast name)] of every stored AST."""
+        entries = []
+        for name in os.listdir(self.directory):
+            if not name.endswith(".ast"):
+                continue
+            try:
+                st = os.stat(self._path(name))
+            except OSError:
+                continue
+            entries.append((st.st_mtime, st.st_size, name))
+        return entries
+
+    @property
+    def size(self):
+        """Bytes used by the stored ASTs."""
+        return sum(size for _, size, _ in self._entries())
+
+    def _evict(self):
+        if self.max_bytes is None:
+            return
+        entries = sorted(self._entries())
+        total = sum(size for _, size, _ in entries)
+        # Keep the most recent entry even if it alone exceeds the cap.
+        for _, size, name in entries[:-1]:
+            if total <= self.max_bytes:
+                break
+            self._remove(name)
+            self._remove(name.split("-", 1)[0] + ".json")
+            total -= size
+            self.evictions += 1
+
+    def clear(self):
+        for name in os.listdir(self.directory):
+            if name.endswith((".ast", ".json")):
+                self._remove(name)
+
+    def stats(self):
+        return {
+            "hits": self.hits,
+            "misses": self.misses,
+            "stale": self.stale,
+            "stores": self.stores,
+            "store_errors": self.store_errors,
+            "load_errors": self.load_errors,
+            "evictions": self.evictions,
+            "size": self.size,
+        }
+
+
+@_sync_only_methods
 class File(ClangObject):
     """
     The File class represents a particular source file that is part of a
@@ -2017,11 +3346,26 @@ class File(ClangObject):
     @staticmethod
     def from_name(translation_unit, file_name):
         """Retrieve a file handle within the given translation unit."""
-        return File(conf.lib.clang_getFile(translation_unit, fspath(file_name)))
+        return File._of(
+            translation_unit,
+            conf.lib.clang_getFile(translation_unit, fspath(file_name)),
+        )
+
+    @staticmethod
+    def _of(tu, obj):
+        """File(obj), remembering the TranslationUnit obj belongs to."""
+        res = File(obj)
+        if res is not None:
+            res._tu = tu
+        return res
 
     @property
     def name(self):
         """Return the complete file and path name of the file."""
+        tu = getattr(self, "_tu", None)
+        if tu is not None:
+            # Interned when the TU interns its strings.
+            return _C.file_name(tu, self)
         return conf.lib.clang_getFileName(self)
 
     @property
@@ -2029,6 +3373,11 @@ class File(ClangObject):
         """Return the last modification time of the file."""
         return conf.lib.clang_getFileTime(self)
 
+    @property
+    def unique_id(self):
+        """(device, inode, mtime) identifying the underlying file, or None."""
+        return _C.file_unique_id(self)
+
     def __str__(self):
         return self.name
 
@@ -2199,7 +3548,263 @@ class CompilationDatabase(ClangObject):
         return conf.lib.clang_CompilationDatabase_getAllCompileCommands(self)
 
 
+class IncrementalIndexer(object):
+    """Keeps a set of translation units parsed and re-parses only those a
+    change affects.
+
+    commands is an iterable of CompileCommand objects or (filename, args)
+    pairs, as for Index.parse_many. After build(), the inclusion graph of
+    every translation unit is known. It is collected natively with
+    clang_getInclusions, with files identified by the (device, inode) part of
+    clang_getFileUniqueID so differently spelled paths to one header match.
+    Each file also gets its mtime, size and content hash recorded.
+
+    update() finds the files whose contents changed, or takes them as
+    arguments, and reparses just the translation units including them.
+    Resident translation units are reparsed in place with
+    clang_reparseTranslationUnit, the others are parsed again in parallel.
+    """
+
+    def __init__(
+            self, commands, index=None, options=None, workers=None,
+            keep_resident=True
+    ):
+        if index is None:
+            index = Index.create()
+        self.index = index
+        self.options = options
+        self.workers = workers
+        self.keep_resident = keep_resident
+        self._commands = {}
+        for cmd in commands:
+            self._commands[self._key(cmd)] = cmd
+        self._tus = {}  # key -> resident TranslationUnit
+        self._includes = {}  # key -> set of file ids
+        self._users = {}  # file id -> set of keys
+        self._files = {}  # file id -> [path, mtime_ns, size, sha256]
+        self.errors = {}  # key -> TranslationUnitLoadError of the last parse
+        self.parses = 0
+        self.reparses = 0
+
+    @staticmethod
+    def _key(cmd):
+        if isinstance(cmd, CompileCommand):
+            return (
+                os.path.join(cmd.directory, cmd.filename),
+                tuple(cmd.arguments),
+            )
+        filename, args = cmd
+        return fspath(filename), tuple(args or ())
+
+    def _base_dir(self, key):
+        cmd = self._commands[key]
+        if isinstance(cmd, CompileCommand):
+            return cmd.directory
+        return os.getcwd()
+
+    @staticmethod
+    def _file_id(path, unique_id):
+        if unique_id is not None:
+            return unique_id[:2]
+        return os.path.abspath(path)
+
+    @staticmethod
+    def _fingerprint(path):
+        st = os.stat(path)
+        with open(path, "rb") as f:
+            digest = hashlib.sha256(f.read()).hexdigest()
+        return [path, st.st_mtime_ns, st.st_size, digest]
+
+    def __len__(self):
+        return len(self._commands)
+
+    def __getitem__(self, key):
+        """The resident TranslationUnit of a key from keys()."""
+        return self._tus[key]
+
+    def keys(self):
+        return list(self._commands)
+
+    def build(self):
+        """Parse every command and record its inclusion graph."""
+        self._parse(list(self._commands))
+
+    def _parse(self, keys):
+        commands = [self._commands[key] for key in keys]
+        for cmd, result in self.index.parse_many(
+                commands, workers=self.workers, options=self.options
+        ):
+            key = self._key(cmd)
+            self.parses += 1
+            if isinstance(result, TranslationUnitLoadError):
+                self.errors[key] = result
+                self._forget(key)
+                continue
+            self.errors.pop(key, None)
+            self._record(key, result)
+
+    def _forget(self, key):
+        self._tus.pop(key, None)
+        for fid in self._includes.pop(key, ()):
+            users = self._users.get(fid)
+            if users is not None:
+                users.discard(key)
+                if not users:
+                    del self._users[fid]
+                    self._files.pop(fid, None)
+
+    def _record(self, key, tu):
+        self._forget(key)
+        base = self._base_dir(key)
+        includes = set()
+        for name, _, _, unique_id in _C.inclusion_graph(tu):
+            path = os.path.normpath(os.path.join(base, name))
+            fid = self._file_id(path, unique_id)
+            includes.add(fid)
+            if fid not in self._files:
+                try:
+                    self._files[fid] = self._fingerprint(path)
+                except OSError:
+                    self._files[fid] = [path, None, None, None]
+        self._includes[key] = includes
+        for fid in includes:
+            self._users.setdefault(fid, set()).add(key)
+        if self.keep_resident:
+            self._tus[key] = tu
+
+    def changed_files(self):
+        """Ids of recorded files whose contents differ from the last parse."""
+        changed = []
+        for fid, (path, mtime_ns, size, digest) in self._files.items():
+            try:
+                st = os.stat(path)
+                if st.st_mtime_ns == mtime_ns and st.st_size == size:
+                    continue
+                if self._fingerprint(path)[3] == digest:
+                    continue
+            except OSError:
+                pass
+            changed.append(fid)
+        return changed
+
+    def _ids_of(self, paths):
+        by_path = {entry[0]: fid for fid, entry in self._files.items()}
+        ids = []
+        for path in paths:
+            path = os.path.abspath(fspath(path))
+            try:
+                st = os.stat(path)
+                fid = (st.st_dev, st.st_ino)
+                if fid in self._files:
+                    ids.append(fid)
+                    continue
+            except OSError:
+                pass
+            if path in by_path:
+                ids.append(by_path[path])
+        return ids
+
+    def affected_by(self, paths):
+        """Keys of the translation units including any of `paths`."""
+        return self._affected(self._ids_of(paths))
+
+    def _affected(self, ids):
+        affected = set()
+        for fid in ids:
+            affected |= self._users.get(fid, set())
+        return sorted(affected)
+
+    def update(self, changed=None, unsaved_files=None):
+        """Reparse the translation units affected by a change.
+
+        changed is an iterable of paths. When None, every recorded file is
+        checked for changed contents. Failed parses are retried each time.
+        Returns the keys that were reparsed.
+        """
+        ids = self.changed_files() if changed is None else self._ids_of(changed)
+        affected = set(self._affected(ids)) | set(self.errors)
+        for fid in ids:
+            # Refingerprinted by _record once its users are reparsed.
+            self._files.pop(fid, None)
+
+        # Read file objects once, the same contents go to every reparse.
+        unsaved_set = TranslationUnit._to_unsaved_file_set(unsaved_files)
+        to_parse = []
+        for key in sorted(affected):
+            tu = self._tus.get(key)
+            if tu is None:
+                to_parse.append(key)
+                continue
+            err = conf.lib.clang_reparseTranslationUnit(
+                tu, unsaved_set, _C.clang_defaultReparseOptions(tu)
+            )
+            if err != 0:
+                # Only disposing a TU is valid after a failed reparse, drop
+                # it and parse from scratch.
+                del self._tus[key]
+                del tu
+                to_parse.append(key)
+                continue
+            self.reparses += 1
+            self._record(key, tu)
+        if to_parse:
+            self._parse(to_parse)
+        return sorted(affected)
+
+    def stats(self):
+        return {
+            "translation_units": len(self._commands),
+            "resident": len(self._tus),
+            "files": len(self._files),
+            "errors": len(self.errors),
+            "parses": self.parses,
+            "reparses": self.reparses,
+        }
+
+
+@_enhance(_C.SymbolIndex)
+class SymbolIndex:
+    """Read-only, memory-mapped symbol index file.
+
+    Index files are written by `_C.SymbolIndexBuilder` from
+    TranslationUnit.index_symbols() / Index.index_file() records or from
+    Cursor.export_columns(), one unit (usually a translation unit) at a
+    time. A builder can load an existing file, replace the units that changed
+    and write it back.
+
+    USRs are kept sorted, lookup(usr, role_mask=0) finds the postings of a
+    USR by binary search and returns (file, line, column, offset, role)
+    tuples. Nothing is loaded beyond the pages touched.
+    """
+
+    def definitions(self, usr):
+        """Locations where `usr` is defined."""
+        return self.lookup(usr, int(_C.CXSymbolRole.CXSymbolRole_Definition))
+
+    def declarations(self, usr):
+        """Locations where `usr` is declared, definitions included."""
+        return self.lookup(usr, int(_C.CXSymbolRole.CXSymbolRole_Declaration))
+
+    def references(self, usr):
+        """Locations where `usr` is referenced."""
+        return self.lookup(usr, int(_C.CXSymbolRole.CXSymbolRole_Reference))
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info):
+        self.close()
+
+
+SymbolIndexBuilder = _C.SymbolIndexBuilder
+
+# A set of cursors backed by clang_createCXCursorSet. add(cursor) returns
+# whether the cursor was new, `cursor in s` does not create Python objects.
+CursorSet = _C.CursorSet
+
+
 @_enhance(_C.CXToken)
+@_sync_only_methods
 class Token:
     """Represents a single token from the preprocessor.
 
@@ -2226,7 +3831,9 @@ class Token:
     @property
     def location(self):
         """The SourceLocation this Token occurs at."""
-        return conf.lib.clang_getTokenLocation(self._tu, self)
+        loc = conf.lib.clang_getTokenLocation(self._tu, self)
+        loc._tu = self._tu
+        return loc
 
     @property
     def extent(self):
@@ -2236,6 +3843,9 @@ class Token:
     @property
     def cursor(self):
         """The Cursor this Token corresponds to."""
+        if hasattr(self, "_group"):
+            return self._group.cursor(self._index)
+
         cursor = Cursor()
         cursor._tu = self._tu
 
@@ -2244,50 +3854,28 @@ class Token:
         return cursor
 
 
+# Functions returning CXString are converted to str natively by the binding.
 __force_wrap_return_map = [
     ("clang_CompilationDatabase_getAllCompileCommands", CompileCommands),
     ("clang_CompilationDatabase_getCompileCommands", CompileCommands),
-    ("clang_CompileCommand_getArg", _CXString),
-    ("clang_CompileCommand_getDirectory", _CXString),
-    ("clang_CompileCommand_getFilename", _CXString),
-    ("clang_formatDiagnostic", _CXString),
     ("clang_getArgType", Type),
     ("clang_getArrayElementType", Type),
     ("clang_getCanonicalType", Type),
-    ("clang_getCompletionBriefComment", _CXString),
-    ("clang_getCompletionChunkText", _CXString),
     ("clang_getCursorDefinition", Cursor),
-    ("clang_getCursorDisplayName", _CXString),
     ("clang_getCursorReferenced", Cursor),
     ("clang_getCursorResultType", Type),
-    ("clang_getCursorSpelling", _CXString),
     ("clang_getCursorType", Type),
-    ("clang_getCursorUSR", _CXString),
-    ("clang_Cursor_getMangling", _CXString),
-    ("clang_getDeclObjCTypeEncoding", _CXString),
-    ("clang_getDiagnosticCategoryText", _CXString),
-    ("clang_getDiagnosticFixIt", _CXString),
-    ("clang_getDiagnosticOption", _CXString),
-    ("clang_getDiagnosticSpelling", _CXString),
     ("clang_getElementType", Type),
     ("clang_getEnumDeclIntegerType", Type),
-    ("clang_getFileName", _CXString),
     ("clang_getIBOutletCollectionType", Type),
     ("clang_getIncludedFile", File),
     ("clang_getPointeeType", Type),
     ("clang_getResultType", Type),
-    ("clang_getTokenSpelling", _CXString),
     ("clang_getTranslationUnitCursor", Cursor),
-    ("clang_getTranslationUnitSpelling", _CXString),
     ("clang_getTypeDeclaration", Cursor),
     ("clang_getTypedefDeclUnderlyingType", Type),
-    ("clang_getTypedefName", _CXString),
-    ("clang_getTypeKindSpelling", _CXString),
-    ("clang_getTypeSpelling", _CXString),
     ("clang_Cursor_getArgument", Cursor),
     ("clang_Cursor_getTemplateArgumentType", Type),
-    ("clang_Cursor_getBriefCommentText", _CXString),
-    ("clang_Cursor_getRawCommentText", _CXString),
     ("clang_Type_getClassType", Type),
     ("clang_Type_getTemplateArgumentAsType", Type),
     ("clang_Type_getNamedType", Type),
@@ -2303,25 +3891,35 @@ def __force_wrap_return():
 
 __force_wrap_return()
 __all__ = [
+    "AstCache",
     "AvailabilityKind",
     "CodeCompletionResults",
     "CompilationDatabase",
     "CompileCommands",
     "CompileCommand",
+    "CompletionService",
     "CursorKind",
     "Cursor",
+    "CursorSet",
     "Diagnostic",
     "File",
     "FixIt",
+    "IncrementalIndexer",
     "Index",
+    "IndexSession",
     "LinkageKind",
+    "SerializedDiagnosticsError",
     "SourceLocation",
     "SourceRange",
+    "SymbolIndex",
+    "SymbolIndexBuilder",
     "TLSKind",
     "TokenKind",
     "Token",
     "TranslationUnitLoadError",
     "TranslationUnit",
+    "TranslationUnitPool",
     "TypeKind",
     "Type",
+    "UnsavedFileSet",
 ]
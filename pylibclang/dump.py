@@ -0,0 +1,116 @@
+"""Stream ASTs as NDJSON or MessagePack.
+
+    python -m pylibclang.dump [options] file.c [-- clang args]
+    python -m pylibclang.dump [options] -p build/compile_commands.json
+
+For every translation unit a {"tu", "args"} record is written, followed by
+one record per node (see Cursor.dump). Nodes are serialized natively while
+the AST is visited, so memory stays flat regardless of the translation unit
+size. At most --jobs translation units are alive at a time, the one being
+dumped and the ones parsed ahead of it (two with --jobs 1).
+"""
+
+import argparse
+import os
+import sys
+
+from pylibclang import _C
+from pylibclang.cindex import (
+    CompilationDatabase,
+    CompileCommand,
+    Index,
+    TranslationUnitLoadError,
+)
+
+_FORMATS = {"ndjson": _C.DUMP_NDJSON, "msgpack": _C.DUMP_MSGPACK}
+
+
+def _commands(opts):
+    if opts.compile_commands:
+        path = opts.compile_commands
+        if os.path.isfile(path):
+            path = os.path.dirname(os.path.abspath(path))
+        db = CompilationDatabase.fromDirectory(path)
+        if opts.files:
+            for f in opts.files:
+                for cmd in db.getCompileCommands(f) or ():
+                    yield cmd
+        else:
+            for cmd in db.getAllCompileCommands():
+                yield cmd
+    else:
+        for f in opts.files:
+            yield f, opts.args
+
+
+def _describe(cmd):
+    if isinstance(cmd, CompileCommand):
+        return os.path.join(cmd.directory, cmd.filename), list(cmd.arguments)
+    filename, args = cmd
+    return filename, list(args)
+
+
+def main(argv=None):
+    argv = sys.argv[1:] if argv is None else list(argv)
+    clang_args = []
+    if "--" in argv:
+        split = argv.index("--")
+        argv, clang_args = argv[:split], argv[split + 1:]
+
+    parser = argparse.ArgumentParser(
+        prog="python -m pylibclang.dump",
+        description="Stream ASTs as NDJSON or MessagePack.",
+    )
+    parser.add_argument("files", nargs="*", help="source files to dump")
+    parser.add_argument(
+        "-p", "--compile-commands",
+        help="compile_commands.json or the directory containing it",
+    )
+    parser.add_argument("-f", "--format", choices=sorted(_FORMATS), default="ndjson")
+    parser.add_argument("-o", "--output", help="output file (default: stdout)")
+    parser.add_argument("-j", "--jobs", type=int, default=1,
+                        help="translation units parsed or dumped in parallel")
+    parser.add_argument("--no-type", action="store_true",
+                        help="omit type spellings")
+    parser.add_argument("--no-usr", action="store_true", help="omit USRs")
+    parser.add_argument("--main-file-only", action="store_true",
+                        help="skip nodes outside the main file")
+    parser.add_argument("--max-depth", type=int, default=-1)
+    opts = parser.parse_args(argv)
+    opts.args = clang_args
+    if not opts.files and not opts.compile_commands:
+        parser.error("no input files")
+
+    if opts.output:
+        fd = os.open(opts.output, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644)
+    else:
+        sys.stdout.flush()
+        fd = sys.stdout.fileno()
+
+    failed = 0
+    try:
+        # The translation unit being dumped counts against --jobs too.
+        ahead = max(opts.jobs - 1, 1)
+        results = Index.create().parse_many(
+            _commands(opts), workers=ahead, max_in_flight=ahead
+        )
+        for cmd, tu in results:
+            filename, args = _describe(cmd)
+            if isinstance(tu, TranslationUnitLoadError):
+                print("%s: %s" % (filename, tu), file=sys.stderr)
+                failed += 1
+                continue
+            _C.dump_ast(
+                tu.cursor, fd, _FORMATS[opts.format], not opts.no_type,
+                not opts.no_usr, opts.main_file_only, opts.max_depth,
+                filename, args
+            )
+            del tu
+    finally:
+        if opts.output:
+            os.close(fd)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,16 @@
+import pytest
+
+from pylibclang import cindex
+
+
+@pytest.fixture
+def parse():
+    """parse(source, name="t.c", args=None, headers=()) builds a
+    TranslationUnit from unsaved files, headers are (name, contents) pairs."""
+    index = cindex.Index.create()
+
+    def parse(source, name="t.c", args=None, headers=()):
+        unsaved = [(name, source)] + list(headers)
+        return index.parse(name, args, unsaved_files=unsaved)
+
+    return parse
@@ -0,0 +1,129 @@
+//
+// License: MIT
+//
+
+#include "ast_dump.h"
+
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+
+#include <gtest/gtest.h>
+
+#include "test_util.h"
+
+namespace {
+
+using ast_dump::FdWriter;
+using ast_dump::Format;
+using ast_dump::RecordWriter;
+
+class AstDumpTest : public ::testing::Test {
+protected:
+  /// Run `fn` on a writer of `format` and return what it wrote.
+  template <class FnT> std::string Render(Format format, FnT fn) {
+    auto path = dir_.Path("out");
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    {
+      // A tiny chunk size exercises flushing in the middle of records.
+      FdWriter out(fd, 3);
+      RecordWriter r(out, format);
+      fn(r);
+    }
+    ::close(fd);
+    std::ifstream f(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), {});
+  }
+
+  TempDir dir_;
+};
+
+TEST_F(AstDumpTest, Ndjson) {
+  auto out = Render(Format::kNdjson, [](RecordWriter &r) {
+    r.Begin(4);
+    r.Key("a");
+    r.Int(-5);
+    r.Key("b");
+    r.Str("q\"\\\n\t\x01");
+    r.Key("c");
+    r.Null();
+    r.Key("d");
+    r.StrArray({"x", "y"});
+    r.End();
+  });
+  EXPECT_EQ(out, "{\"a\":-5,\"b\":\"q\\\"\\\\\\n\\t\\u0001\",\"c\":null,"
+                 "\"d\":[\"x\",\"y\"]}\n");
+}
+
+TEST_F(AstDumpTest, Msgpack) {
+  auto out = Render(Format::kMsgpack, [](RecordWriter &r) {
+    r.Begin(3);
+    r.Key("a");
+    r.Int(-1);
+    r.Key("b");
+    r.Int(300);
+    r.Key("c");
+    r.Null();
+  });
+  EXPECT_EQ(out, std::string("\x83\xa1"
+                             "a\xff\xa1"
+                             "b\xce\x00\x00\x01\x2c\xa1"
+                             "c\xc0",
+                             14));
+
+  out = Render(Format::kMsgpack, [](RecordWriter &r) {
+    r.Int(-33);
+    r.Str(std::string(40, 's'));
+    r.Begin(16);
+  });
+  EXPECT_EQ(out.substr(0, 9), std::string("\xd3\xff\xff\xff\xff\xff\xff\xff"
+                                          "\xdf",
+                                          9));
+  EXPECT_EQ(out.substr(9, 2), "\xd9\x28");
+  EXPECT_EQ(out.substr(11, 40), std::string(40, 's'));
+  EXPECT_EQ(out.substr(51), std::string("\xde\x00\x10", 3));
+}
+
+TEST_F(AstDumpTest, DumpsTranslationUnit) {
+  static const char kSource[] = "int add(int a, int b) { return a + b; }";
+  CXIndex index = clang_createIndex(0, 0);
+  CXUnsavedFile unsaved{"t.c", kSource, sizeof(kSource) - 1};
+  CXTranslationUnit tu = clang_parseTranslationUnit(
+      index, "t.c", nullptr, 0, &unsaved, 1, CXTranslationUnit_None);
+  ASSERT_NE(tu, nullptr);
+
+  auto path = dir_.Path("out");
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ast_dump::Options options;
+  options.with_usr = false;
+  options.main_file_only = true;
+  options.max_depth = 2;
+  uint64_t nodes;
+  {
+    ast_dump::Dumper dumper(fd, options);
+    dumper.WriteTranslationUnit("t.c", {"-std=c11"});
+    // The translation unit, the function and its two parameters and body.
+    nodes = dumper.Dump(clang_getTranslationUnitCursor(tu));
+  }
+  ::close(fd);
+  clang_disposeTranslationUnit(tu);
+  clang_disposeIndex(index);
+
+  EXPECT_EQ(nodes, 5u);
+  std::ifstream f(path);
+  std::string line;
+  std::vector<std::string> lines;
+  while (std::getline(f, line)) {
+    lines.push_back(line);
+  }
+  ASSERT_EQ(lines.size(), 6u);
+  EXPECT_EQ(lines[0], "{\"tu\":\"t.c\",\"args\":[\"-std=c11\"]}");
+  EXPECT_EQ(lines[2].rfind("{\"id\":1,\"parent\":0,\"kind\":\"FunctionDecl\","
+                           "\"spelling\":\"add\",\"type\":\"int (int, int)\"",
+                           0),
+            0u);
+  EXPECT_NE(lines[5].find("\"id\":4,\"parent\":1,\"kind\":\"CompoundStmt\""),
+            std::string::npos);
+}
+
+} // namespace
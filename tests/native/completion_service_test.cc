@@ -0,0 +1,135 @@
+//
+// License: MIT
+//
+
+#include "completion_service.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using completion::LatencyHistogram;
+using completion::Service;
+
+TEST(LatencyHistogramTest, Empty) {
+  LatencyHistogram h;
+  EXPECT_EQ(h.count(), 0u);
+  EXPECT_EQ(h.Percentile(0.5), 0u);
+  EXPECT_EQ(h.mean(), 0.0);
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+  LatencyHistogram h;
+  for (uint64_t v : {0, 1, 2, 3, 4, 5, 6, 7}) {
+    h.Record(v);
+  }
+  EXPECT_EQ(h.Percentile(0.5), 3u);
+  EXPECT_EQ(h.Percentile(1.0), 7u);
+  EXPECT_EQ(h.mean(), 3.5);
+}
+
+TEST(LatencyHistogramTest, PercentilesWithinBucketError) {
+  LatencyHistogram h;
+  for (uint64_t v = 1; v <= 10000; ++v) {
+    h.Record(v);
+  }
+  EXPECT_EQ(h.count(), 10000u);
+  EXPECT_EQ(h.max(), 10000u);
+  for (double q : {0.5, 0.9, 0.99}) {
+    auto exact = static_cast<double>(q * 10000);
+    auto p = static_cast<double>(h.Percentile(q));
+    EXPECT_GE(p, exact) << q;
+    EXPECT_LE(p, exact * 1.25) << q;
+  }
+  EXPECT_EQ(h.Percentile(1.0), 10000u); // capped at the maximum
+  EXPECT_EQ(h.Percentile(0.0), 1u);
+
+  LatencyHistogram big;
+  big.Record(UINT64_MAX);
+  EXPECT_EQ(big.Percentile(0.5), UINT64_MAX);
+}
+
+class ServiceTest : public ::testing::Test {
+protected:
+  static constexpr char kSource[] =
+      "struct P { int x_pos; int y_pos; int xray; };\n"
+      "void f(struct P p) { p. }\n";
+
+  std::vector<std::pair<std::string, std::string>> Unsaved() {
+    return {{"t.c", kSource}};
+  }
+
+  Service::Request At(const std::string &prefix) {
+    Service::Request r;
+    r.filename = "t.c";
+    r.line = 2;
+    r.column = 24;
+    r.unsaved_files = Unsaved();
+    r.options = clang_defaultCodeCompleteOptions();
+    r.prefix = prefix;
+    return r;
+  }
+};
+
+TEST_F(ServiceTest, Completes) {
+  Service service("t.c", {}, Unsaved(), 0);
+  auto id = service.Submit(At("y"));
+  auto r = service.Wait(id, -1);
+  ASSERT_TRUE(r.has_value());
+  EXPECT_EQ(r->status, Service::Status::kDone);
+  ASSERT_EQ(r->items.size(), 2u);
+  EXPECT_EQ(r->items[0].typed_text, "y_pos");
+  EXPECT_GT(r->seconds, 0.0);
+
+  // Collected results are gone.
+  EXPECT_EQ(service.Wait(id, 0)->status, Service::Status::kDropped);
+  EXPECT_FALSE(service.Cancel(id));
+  EXPECT_THROW(service.Wait(id + 1, 0), std::out_of_range);
+
+  auto stats = service.GetStats();
+  EXPECT_EQ(stats.submitted, 1u);
+  EXPECT_EQ(stats.completed, 1u);
+  EXPECT_EQ(stats.latency.count(), 1u);
+}
+
+TEST_F(ServiceTest, OnlyTheLatestRequestPerFileCompletes) {
+  Service service("t.c", {}, Unsaved(), 0);
+  std::vector<int64_t> ids;
+  for (int i = 0; i < 20; ++i) {
+    ids.push_back(service.Submit(At("")));
+  }
+  auto last = service.Wait(ids.back(), -1);
+  ASSERT_TRUE(last.has_value());
+  EXPECT_EQ(last->status, Service::Status::kDone);
+  EXPECT_EQ(last->items.size(), 3u);
+  for (size_t i = 0; i + 1 < ids.size(); ++i) {
+    EXPECT_EQ(service.Wait(ids[i], -1)->status, Service::Status::kDropped);
+  }
+  auto stats = service.GetStats();
+  EXPECT_EQ(stats.submitted, 20u);
+  EXPECT_EQ(stats.completed, 1u);
+  // Each superseded request was either replaced in the queue or finished
+  // too late.
+  EXPECT_EQ(stats.coalesced + stats.dropped, 19u);
+}
+
+TEST_F(ServiceTest, Cancel) {
+  Service service("t.c", {}, Unsaved(), 0);
+  auto id = service.Submit(At(""));
+  if (service.Cancel(id)) {
+    EXPECT_EQ(service.Wait(id, -1)->status, Service::Status::kDropped);
+    EXPECT_EQ(service.GetStats().cancelled, 1u);
+  } else {
+    // It finished before it could be cancelled.
+    EXPECT_EQ(service.Wait(id, -1)->status, Service::Status::kDone);
+  }
+}
+
+TEST_F(ServiceTest, CloseAndErrors) {
+  EXPECT_THROW(Service("missing.c", {}, {}, 0), std::runtime_error);
+  Service service("t.c", {}, Unsaved(), 0);
+  service.Close();
+  EXPECT_THROW(service.Submit(At("")), std::runtime_error);
+}
+
+} // namespace
@@ -0,0 +1,95 @@
+//
+// License: MIT
+//
+
+#include "completion.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using completion::FuzzyScore;
+
+TEST(FuzzyScoreTest, Matches) {
+  EXPECT_EQ(FuzzyScore("", "anything"), 1);
+  EXPECT_EQ(FuzzyScore("xyz", "xy"), 0);
+  EXPECT_EQ(FuzzyScore("ba", "ab"), 0); // order matters
+  EXPECT_GT(FuzzyScore("pb", "push_back"), 0);
+  EXPECT_GT(FuzzyScore("PB", "push_back"), 0); // case-insensitive
+}
+
+TEST(FuzzyScoreTest, Ranking) {
+  // Exact match beats prefix beats subsequence.
+  EXPECT_GT(FuzzyScore("size", "size"), FuzzyScore("size", "sizeof"));
+  EXPECT_GT(FuzzyScore("size", "sizeof"), FuzzyScore("size", "resize"));
+  // Exact case wins.
+  EXPECT_GT(FuzzyScore("get", "getX"), FuzzyScore("get", "GetX"));
+  // Word starts, after '_' or a lower-to-upper change, beat other letters.
+  EXPECT_GT(FuzzyScore("pb", "push_back"), FuzzyScore("pb", "problem"));
+  EXPECT_GT(FuzzyScore("gv", "getValue"), FuzzyScore("gv", "grove"));
+  // Consecutive runs win.
+  EXPECT_GT(FuzzyScore("ab", "abx"), FuzzyScore("ab", "axb"));
+}
+
+class RankTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    index_ = clang_createIndex(0, 0);
+    CXUnsavedFile unsaved{"t.c", kSource, sizeof(kSource) - 1};
+    tu_ = clang_parseTranslationUnit(index_, "t.c", nullptr, 0, &unsaved, 1,
+                                     CXTranslationUnit_None);
+    ASSERT_NE(tu_, nullptr);
+    // Right after "p." on the second line.
+    results_ = clang_codeCompleteAt(tu_, "t.c", 2, 24, &unsaved, 1,
+                                    clang_defaultCodeCompleteOptions());
+    ASSERT_NE(results_, nullptr);
+  }
+
+  void TearDown() override {
+    if (results_) {
+      clang_disposeCodeCompleteResults(results_);
+    }
+    if (tu_) {
+      clang_disposeTranslationUnit(tu_);
+    }
+    clang_disposeIndex(index_);
+  }
+
+  std::vector<std::string> Rank(std::string_view prefix, size_t limit) {
+    std::vector<std::string> names;
+    for (auto &item : completion::Rank(results_, prefix, limit)) {
+      names.push_back(item.typed_text);
+    }
+    return names;
+  }
+
+  static constexpr char kSource[] =
+      "struct P { int x_pos; int y_pos; int xray; };\n"
+      "void f(struct P p) { p. }\n";
+  CXIndex index_ = nullptr;
+  CXTranslationUnit tu_ = nullptr;
+  CXCodeCompleteResults *results_ = nullptr;
+};
+
+TEST_F(RankTest, FiltersAndOrders) {
+  EXPECT_EQ(Rank("", 0),
+            (std::vector<std::string>{"x_pos", "xray", "y_pos"}));
+  EXPECT_EQ(Rank("", 2), (std::vector<std::string>{"x_pos", "xray"}));
+  EXPECT_EQ(Rank("pos", 0), (std::vector<std::string>{"x_pos", "y_pos"}));
+  EXPECT_EQ(Rank("yp", 0), (std::vector<std::string>{"y_pos"}));
+  // A prefix match ranks above a match inside the name.
+  EXPECT_EQ(Rank("y", 0), (std::vector<std::string>{"y_pos", "xray"}));
+  EXPECT_TRUE(Rank("q", 0).empty());
+  EXPECT_TRUE(completion::Rank(nullptr, "", 0).empty());
+}
+
+TEST_F(RankTest, DescribesSurvivors) {
+  auto items = completion::Rank(results_, "xray", 1);
+  ASSERT_EQ(items.size(), 1u);
+  EXPECT_EQ(items[0].display, "xray");
+  EXPECT_EQ(items[0].result_type, "int");
+  EXPECT_EQ(items[0].cursor_kind, CXCursor_FieldDecl);
+  EXPECT_EQ(items[0].availability, CXAvailability_Available);
+}
+
+} // namespace
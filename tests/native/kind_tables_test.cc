@@ -0,0 +1,79 @@
+//
+// License: MIT
+//
+
+#include "kind_tables.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace kind_tables;
+
+TEST(KindTablesTest, CursorFlagsMatchLibclang) {
+  auto kinds = CursorKinds();
+  ASSERT_FALSE(kinds.empty());
+  for (auto kind : kinds) {
+    auto k = static_cast<CXCursorKind>(kind);
+    uint32_t flags = CursorKindFlags(kind);
+    SCOPED_TRACE(kind);
+    EXPECT_EQ(!!(flags & kCursorDeclaration), !!clang_isDeclaration(k));
+    EXPECT_EQ(!!(flags & kCursorReference), !!clang_isReference(k));
+    EXPECT_EQ(!!(flags & kCursorExpression), !!clang_isExpression(k));
+    EXPECT_EQ(!!(flags & kCursorStatement), !!clang_isStatement(k));
+    EXPECT_EQ(!!(flags & kCursorAttribute), !!clang_isAttribute(k));
+    EXPECT_EQ(!!(flags & kCursorInvalid), !!clang_isInvalid(k));
+    EXPECT_EQ(!!(flags & kCursorTranslationUnit), !!clang_isTranslationUnit(k));
+    EXPECT_EQ(!!(flags & kCursorPreprocessing), !!clang_isPreprocessing(k));
+    EXPECT_EQ(!!(flags & kCursorUnexposed), !!clang_isUnexposed(k));
+  }
+}
+
+TEST(KindTablesTest, RangeBoundaries) {
+  EXPECT_EQ(CursorKindFlags(CXCursor_FirstDecl),
+            kCursorDeclaration | kCursorUnexposed);
+  EXPECT_EQ(CursorKindFlags(CXCursor_LastDecl), kCursorDeclaration);
+  EXPECT_EQ(CursorKindFlags(CXCursor_LastDecl + 1), kCursorReference);
+  EXPECT_EQ(CursorKindFlags(CXCursor_LastRef + 1), 0u);
+  EXPECT_EQ(CursorKindFlags(CXCursor_UnexposedExpr),
+            kCursorExpression | kCursorUnexposed);
+  EXPECT_EQ(CursorKindFlags(CXCursor_FirstExtraDecl), kCursorDeclaration);
+  EXPECT_EQ(CursorKindFlags(-1), 0u);
+  EXPECT_EQ(CursorKindFlags(kNumCursorKinds), 0u);
+
+  EXPECT_EQ(TypeKindFlags(CXType_Int),
+            kTypeBuiltin | kTypeInteger | kTypeSignedInteger);
+  EXPECT_EQ(TypeKindFlags(CXType_UChar),
+            kTypeBuiltin | kTypeInteger | kTypeUnsignedInteger);
+  EXPECT_EQ(TypeKindFlags(CXType_Bool), kTypeBuiltin);
+  EXPECT_EQ(TypeKindFlags(CXType_Double), kTypeBuiltin | kTypeFloating);
+  EXPECT_EQ(TypeKindFlags(CXType_Void), kTypeBuiltin);
+  EXPECT_EQ(TypeKindFlags(CXType_Pointer), kTypePointer);
+  EXPECT_EQ(TypeKindFlags(CXType_Typedef), kTypeSugar);
+  EXPECT_EQ(TypeKindFlags(CXType_Pipe), kTypeOpenCL);
+  EXPECT_EQ(TypeKindFlags(CXType_Invalid), 0u);
+  EXPECT_EQ(TypeKindFlags(kNumTypeKinds), 0u);
+}
+
+TEST(KindTablesTest, Spellings) {
+  SpellingTable cursors;
+  cursors.Fill(CursorKinds(), [](int k) {
+    return clang_getCursorKindSpelling(static_cast<CXCursorKind>(k));
+  });
+  EXPECT_EQ(cursors.Get(CXCursor_FunctionDecl), "FunctionDecl");
+  EXPECT_EQ(cursors.Get(CXCursor_TranslationUnit), "TranslationUnit");
+  EXPECT_EQ(cursors.Get(CXCursor_OverloadCandidate), "OverloadCandidate");
+  EXPECT_EQ(cursors.Get(CXCursor_LastRef + 1), ""); // no such kind
+  EXPECT_EQ(cursors.Get(-1), "");
+  EXPECT_EQ(cursors.size(), CXCursor_OverloadCandidate + 1u);
+
+  SpellingTable types;
+  types.Fill(TypeKinds(), [](int k) {
+    return clang_getTypeKindSpelling(static_cast<CXTypeKind>(k));
+  });
+  EXPECT_EQ(types.Get(CXType_Int), "Int");
+  EXPECT_EQ(types.Get(CXType_Pointer), "Pointer");
+  EXPECT_EQ(types.Get(kNumTypeKinds), "");
+}
+
+} // namespace
@@ -0,0 +1,92 @@
+//
+// License: MIT
+//
+
+#include "location_decoder.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+class LocationDecoderTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    index_ = clang_createIndex(0, 0);
+    CXUnsavedFile unsaved{"t.c", kSource, sizeof(kSource) - 1};
+    ASSERT_EQ(clang_parseTranslationUnit2(index_, "t.c", nullptr, 0, &unsaved,
+                                          1, CXTranslationUnit_None, &tu_),
+              CXError_Success);
+    file_ = clang_getFile(tu_, "t.c");
+    ASSERT_NE(file_, nullptr);
+  }
+
+  void TearDown() override {
+    if (tu_) {
+      clang_disposeTranslationUnit(tu_);
+    }
+    clang_disposeIndex(index_);
+  }
+
+  CXSourceLocation At(unsigned offset) {
+    return clang_getLocationForOffset(tu_, file_, offset);
+  }
+
+  static constexpr char kSource[] = "int x;\nint y;\n";
+  CXIndex index_ = nullptr;
+  CXTranslationUnit tu_ = nullptr;
+  CXFile file_ = nullptr;
+};
+
+TEST_F(LocationDecoderTest, Decodes) {
+  LocationDecoder decoder(4);
+  auto d = decoder.Decode(At(11));
+  EXPECT_EQ(d.file, 0);
+  EXPECT_EQ(d.line, 2u);
+  EXPECT_EQ(d.column, 5u);
+  EXPECT_EQ(d.offset, 11u);
+  EXPECT_TRUE(clang_File_isEqual(decoder.File(d.file), file_));
+
+  EXPECT_EQ(decoder.Decode(At(4)).file, 0);
+  EXPECT_EQ(decoder.NumFiles(), 1u);
+  EXPECT_EQ(decoder.Decode(clang_getNullLocation()).file, -1);
+  EXPECT_EQ(decoder.File(-1), nullptr);
+}
+
+TEST_F(LocationDecoderTest, EvictsLeastRecentlyUsed) {
+  LocationDecoder decoder(2);
+  decoder.Decode(At(0));
+  decoder.Decode(At(4));
+  EXPECT_EQ(decoder.Decode(At(0)).offset, 0u); // hit, 4 is now the oldest
+  decoder.Decode(At(7));                       // evicts 4
+  EXPECT_EQ(decoder.Size(), 2u);
+  EXPECT_EQ(decoder.Hits(), 1u);
+  EXPECT_EQ(decoder.Misses(), 3u);
+
+  decoder.Decode(At(0));
+  decoder.Decode(At(7));
+  EXPECT_EQ(decoder.Hits(), 3u);
+  EXPECT_EQ(decoder.Decode(At(4)).offset, 4u);
+  EXPECT_EQ(decoder.Misses(), 4u);
+  EXPECT_EQ(decoder.Size(), 2u);
+}
+
+TEST_F(LocationDecoderTest, ZeroCapacityDoesNotCache) {
+  LocationDecoder decoder(0);
+  decoder.Decode(At(0));
+  decoder.Decode(At(0));
+  EXPECT_EQ(decoder.Hits(), 0u);
+  EXPECT_EQ(decoder.Misses(), 2u);
+  EXPECT_EQ(decoder.Size(), 0u);
+}
+
+TEST_F(LocationDecoderTest, ClearKeepsFileIds) {
+  LocationDecoder decoder(4);
+  decoder.DecodeMany({At(0), At(4)});
+  decoder.Clear();
+  EXPECT_EQ(decoder.Size(), 0u);
+  EXPECT_EQ(decoder.NumFiles(), 1u);
+  EXPECT_EQ(decoder.Decode(At(0)).file, 0);
+  EXPECT_EQ(decoder.Misses(), 3u);
+}
+
+} // namespace
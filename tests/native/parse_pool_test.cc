@@ -0,0 +1,83 @@
+//
+// License: MIT
+//
+
+#include "parse_pool.h"
+
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "test_util.h"
+
+namespace {
+
+class ParsePoolTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    for (int i = 0; i < 2; ++i) {
+      indexes_.push_back(clang_createIndex(0, 0));
+    }
+  }
+
+  void TearDown() override {
+    for (auto index : indexes_) {
+      clang_disposeIndex(index);
+    }
+  }
+
+  ParsePool::Job JobFor(int64_t id, const std::string &filename) {
+    ParsePool::Job job;
+    job.id = id;
+    job.filename = filename;
+    return job;
+  }
+
+  TempDir dir_;
+  std::vector<CXIndex> indexes_;
+};
+
+TEST_F(ParsePoolTest, ParsesEveryJobOnce) {
+  std::set<int64_t> ids;
+  {
+    ParsePool pool(indexes_);
+    for (int i = 0; i < 8; ++i) {
+      auto name = "t" + std::to_string(i) + ".c";
+      pool.Submit(JobFor(i, dir_.Write(name, "int x;")));
+    }
+    while (auto r = pool.Next()) {
+      EXPECT_EQ(r->error, CXError_Success);
+      ASSERT_NE(r->tu, nullptr);
+      EXPECT_TRUE(r->worker == 0 || r->worker == 1);
+      clang_disposeTranslationUnit(r->tu);
+      EXPECT_TRUE(ids.insert(r->id).second);
+    }
+    EXPECT_EQ(pool.Pending(), 0u);
+  }
+  EXPECT_EQ(ids.size(), 8u);
+}
+
+TEST_F(ParsePoolTest, ReportsErrors) {
+  ParsePool pool(indexes_);
+  ParsePool::Job job = JobFor(1, dir_.Path("t.c"));
+  job.full_argv = true; // an empty command line
+  pool.Submit(job);
+  auto r = pool.Next();
+  ASSERT_TRUE(r.has_value());
+  EXPECT_EQ(r->id, 1);
+  EXPECT_NE(r->error, CXError_Success);
+  EXPECT_EQ(r->tu, nullptr);
+  EXPECT_FALSE(pool.Next().has_value());
+}
+
+TEST_F(ParsePoolTest, SubmitAfterShutdownThrows) {
+  ParsePool pool(indexes_);
+  pool.Submit(JobFor(1, dir_.Write("t.c", "int x;")));
+  // Unconsumed translation units are disposed by Shutdown().
+  pool.Shutdown();
+  EXPECT_EQ(pool.Pending(), 0u);
+  EXPECT_FALSE(pool.Next().has_value());
+  EXPECT_THROW(pool.Submit(JobFor(2, dir_.Path("t.c"))), std::runtime_error);
+}
+
+} // namespace
@@ -0,0 +1,109 @@
+//
+// License: MIT
+//
+
+#include "serial_executor.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+TEST(SerialExecutorTest, KeysRunInSubmissionOrderOneAtATime) {
+  constexpr int kKeys = 3;
+  constexpr int kTasks = 200;
+  std::vector<int> order[kKeys];
+  std::atomic<int> active[kKeys] = {};
+  std::atomic<bool> overlapped{false};
+  {
+    SerialExecutor executor(4);
+    for (int i = 0; i < kTasks; ++i) {
+      for (int k = 0; k < kKeys; ++k) {
+        executor.Submit(k + 1, [&, k, i] {
+          if (active[k]++) {
+            overlapped = true;
+          }
+          order[k].push_back(i);
+          std::this_thread::yield();
+          --active[k];
+        });
+      }
+    }
+    while (executor.Pending()) {
+      std::this_thread::sleep_for(1ms);
+    }
+  }
+  EXPECT_FALSE(overlapped);
+  for (auto &o : order) {
+    ASSERT_EQ(o.size(), static_cast<size_t>(kTasks));
+    for (int i = 0; i < kTasks; ++i) {
+      EXPECT_EQ(o[i], i);
+    }
+  }
+}
+
+/// Two tasks that only finish if they run at the same time.
+void ExpectParallel(uintptr_t key_a, uintptr_t key_b) {
+  std::promise<void> a_started, b_started;
+  std::atomic<int> met{0};
+  SerialExecutor executor(2);
+  executor.Submit(key_a, [&] {
+    a_started.set_value();
+    met += b_started.get_future().wait_for(5s) == std::future_status::ready;
+  });
+  executor.Submit(key_b, [&] {
+    b_started.set_value();
+    met += a_started.get_future().wait_for(5s) == std::future_status::ready;
+  });
+  while (executor.Pending()) {
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_EQ(met, 2);
+}
+
+TEST(SerialExecutorTest, DifferentKeysRunInParallel) { ExpectParallel(1, 2); }
+
+TEST(SerialExecutorTest, UnkeyedTasksRunInParallel) { ExpectParallel(0, 0); }
+
+TEST(SerialExecutorTest, ShutdownReturnsTasksThatNeverRan) {
+  SerialExecutor executor(1);
+  std::promise<void> release;
+  auto released = release.get_future();
+  std::promise<void> started;
+  executor.Submit(1, [&] {
+    started.set_value();
+    released.wait();
+  });
+  started.get_future().wait();
+  executor.Submit(1, [] {});
+  executor.Submit(2, [] {});
+  executor.Submit(0, [] {});
+  EXPECT_EQ(executor.Pending(), 4u);
+
+  std::vector<SerialExecutor::Task> dropped;
+  std::thread shutdown([&] { dropped = executor.Shutdown(); });
+  // Keep submitting until Shutdown() refuses, every accepted task queues
+  // behind the blocked one.
+  size_t extra = 0;
+  while (true) {
+    try {
+      executor.Submit(3, [] {});
+      ++extra;
+    } catch (const std::runtime_error &) {
+      break;
+    }
+    std::this_thread::yield();
+  }
+  release.set_value();
+  shutdown.join();
+  EXPECT_EQ(dropped.size(), 3 + extra);
+  EXPECT_TRUE(executor.Shutdown().empty());
+  EXPECT_THROW(executor.Submit(0, [] {}), std::runtime_error);
+}
+
+} // namespace
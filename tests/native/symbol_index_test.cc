@@ -0,0 +1,167 @@
+//
+// License: MIT
+//
+
+#include "symbol_index.h"
+
+#include <fstream>
+#include <iterator>
+
+#include <gtest/gtest.h>
+
+#include "test_util.h"
+
+namespace {
+
+using symbol_index::Builder;
+using symbol_index::Header;
+using symbol_index::Posting;
+using symbol_index::Reader;
+
+constexpr uint32_t kDecl = 1; // CXSymbolRole_Declaration
+constexpr uint32_t kRef = 4;  // CXSymbolRole_Reference
+
+void Add(Builder &builder, std::vector<Builder::Entry> &entries,
+         const std::string &usr, const std::string &file, uint32_t offset,
+         uint32_t role) {
+  Builder::Entry e{};
+  e.usr = builder.InternUsr(usr);
+  e.posting.file = builder.InternFile(file);
+  e.posting.line = 1;
+  e.posting.column = offset + 1;
+  e.posting.offset = offset;
+  e.posting.role = role;
+  e.posting.unit = 0;
+  entries.push_back(e);
+}
+
+std::string ReadAll(const std::string &path) {
+  std::ifstream f(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(f), {});
+}
+
+class SymbolIndexTest : public ::testing::Test {
+protected:
+  void SetUp() override { WriteIndex(); }
+
+  void WriteIndex() {
+    path_ = dir_.Path("index");
+    Builder builder;
+    auto &a = builder.ResetUnit("a.c");
+    Add(builder, a, "c:@F@f", "h.h", 4, kDecl);
+    Add(builder, a, "c:@F@f", "a.c", 30, kRef);
+    Add(builder, a, "c:@g", "a.c", 10, kDecl);
+    auto &b = builder.ResetUnit("b.c");
+    // The header is seen again by the second unit.
+    Add(builder, b, "c:@F@f", "h.h", 4, kDecl);
+    Add(builder, b, "c:@F@f", "b.c", 20, kRef);
+    builder.Write(path_);
+  }
+
+  /// Rewrite the index file after applying `edit` to its bytes.
+  template <class EditT> void Corrupt(EditT edit) {
+    auto data = ReadAll(path_);
+    edit(data);
+    std::ofstream(path_, std::ios::binary | std::ios::trunc) << data;
+  }
+
+  TempDir dir_;
+  std::string path_;
+};
+
+TEST_F(SymbolIndexTest, RoundTrip) {
+  Reader reader(path_);
+  EXPECT_EQ(reader.NumSymbols(), 2u);
+  EXPECT_EQ(reader.NumPostings(), 5u);
+  EXPECT_EQ(reader.Symbols().at(0), "c:@F@f"); // sorted bytewise
+  EXPECT_EQ(reader.Units().size(), 2u);
+  EXPECT_EQ(reader.Find("c:@x"), -1);
+  EXPECT_EQ(reader.Find(""), -1);
+
+  int64_t f = reader.Find("c:@F@f");
+  ASSERT_GE(f, 0);
+  auto all = reader.Lookup(f, 0);
+  ASSERT_EQ(all.size(), 3u); // the header declaration is returned once
+  auto decls = reader.Lookup(f, kDecl);
+  ASSERT_EQ(decls.size(), 1u);
+  EXPECT_EQ(reader.Files().at(decls[0].file), "h.h");
+  EXPECT_EQ(decls[0].offset, 4u);
+  EXPECT_EQ(decls[0].column, 5u);
+  auto refs = reader.Lookup(f, kRef);
+  ASSERT_EQ(refs.size(), 2u);
+  EXPECT_EQ(reader.Units().at(refs[0].unit), "a.c");
+
+  int64_t g = reader.Find("c:@g");
+  ASSERT_GE(g, 0);
+  EXPECT_EQ(reader.Lookup(g, 0).size(), 1u);
+}
+
+TEST_F(SymbolIndexTest, LoadReplacesUnits) {
+  Builder builder;
+  {
+    Reader reader(path_);
+    builder.Load(reader);
+  }
+  EXPECT_EQ(builder.UnitNames(), (std::vector<std::string>{"a.c", "b.c"}));
+  EXPECT_EQ(builder.NumPostings(), 5u);
+  // a.c no longer uses g, so the symbol disappears from the index.
+  auto &a = builder.ResetUnit("a.c");
+  Add(builder, a, "c:@F@f", "a.c", 31, kRef);
+  EXPECT_TRUE(builder.RemoveUnit("b.c"));
+  EXPECT_FALSE(builder.RemoveUnit("b.c"));
+  builder.Write(path_);
+
+  Reader reader(path_);
+  EXPECT_EQ(reader.NumSymbols(), 1u);
+  EXPECT_EQ(reader.Find("c:@g"), -1);
+  EXPECT_EQ(reader.Files().size(), 1u);
+  auto refs = reader.Lookup(reader.Find("c:@F@f"), kRef);
+  ASSERT_EQ(refs.size(), 1u);
+  EXPECT_EQ(refs[0].offset, 31u);
+}
+
+TEST_F(SymbolIndexTest, RejectsMissingAndTruncatedFiles) {
+  EXPECT_THROW(Reader(dir_.Path("missing")), std::runtime_error);
+  Corrupt([](std::string &data) { data.resize(sizeof(Header) - 1); });
+  EXPECT_THROW(Reader{path_}, std::runtime_error);
+}
+
+TEST_F(SymbolIndexTest, RejectsBadHeader) {
+  Corrupt([](std::string &data) { data[0] = 'X'; });
+  EXPECT_THROW(Reader{path_}, std::runtime_error);
+  WriteIndex();
+  // The recorded size no longer matches the file.
+  Corrupt([](std::string &data) { data.resize(data.size() - 8); });
+  EXPECT_THROW(Reader{path_}, std::runtime_error);
+}
+
+TEST_F(SymbolIndexTest, RejectsCorruptSections) {
+  auto header = [](std::string &data) {
+    return reinterpret_cast<Header *>(&data[0]);
+  };
+  Corrupt([&](std::string &data) { header(data)->num_postings += 1; });
+  EXPECT_THROW(Reader{path_}, std::runtime_error);
+
+  WriteIndex();
+  Corrupt([&](std::string &data) {
+    // Posting range of the first symbol ends past the one of the second.
+    auto *ranges =
+        reinterpret_cast<uint32_t *>(&data[header(data)->ranges_offset]);
+    ranges[1] = ranges[2] + 1;
+  });
+  EXPECT_THROW(Reader{path_}, std::runtime_error);
+
+  WriteIndex();
+  Corrupt([&](std::string &data) { header(data)->files_offset = data.size(); });
+  EXPECT_THROW(Reader{path_}, std::runtime_error);
+
+  WriteIndex();
+  Corrupt([&](std::string &data) {
+    auto *offsets =
+        reinterpret_cast<uint32_t *>(&data[header(data)->symbols_offset]);
+    offsets[2] = 1u << 30; // last string runs past the table
+  });
+  EXPECT_THROW(Reader{path_}, std::runtime_error);
+}
+
+} // namespace
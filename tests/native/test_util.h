@@ -0,0 +1,50 @@
+//
+// License: MIT
+//
+
+#ifndef PYLIBCLANG_TEST_UTIL_H
+#define PYLIBCLANG_TEST_UTIL_H
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+/// A temporary directory, removed with its contents on destruction.
+class TempDir {
+public:
+  TempDir() {
+    std::string tmpl =
+        (std::filesystem::temp_directory_path() / "pylibclang-XXXXXX")
+            .string();
+    if (!mkdtemp(tmpl.data())) {
+      throw std::runtime_error("mkdtemp failed");
+    }
+    path_ = tmpl;
+  }
+
+  TempDir(const TempDir &) = delete;
+  TempDir &operator=(const TempDir &) = delete;
+
+  ~TempDir() {
+    std::error_code ec;
+    std::filesystem::remove_all(path_, ec);
+  }
+
+  std::string Path(const std::string &name) const {
+    return (path_ / name).string();
+  }
+
+  /// Write `contents` to `name` and return its path.
+  std::string Write(const std::string &name, const std::string &contents) {
+    auto path = Path(name);
+    std::ofstream(path, std::ios::binary) << contents;
+    return path;
+  }
+
+private:
+  std::filesystem::path path_;
+};
+
+#endif // PYLIBCLANG_TEST_UTIL_H
@@ -0,0 +1,29 @@
+from pylibclang.cindex import CursorKind
+
+SOURCE = "int add(int a, int b) { return a + b; }"
+
+
+def test_annotate_tokens(parse):
+    tu = parse(SOURCE)
+    tokens = list(tu.get_tokens(extent=tu.cursor.extent))
+    cursors = tu.annotate_tokens(extent=tu.cursor.extent)
+    assert len(cursors) == len(tokens)
+    assert [c.kind for c in cursors] == [t.cursor.kind for t in tokens]
+    assert cursors[1].kind == CursorKind.CXCursor_FunctionDecl
+    assert cursors[11].kind == CursorKind.CXCursor_DeclRefExpr
+    assert cursors[11].referenced.spelling == "a"
+
+
+def test_annotate_tokens_packed(parse):
+    tu = parse(SOURCE)
+    packed = tu.annotate_tokens_packed(extent=tu.cursor.extent)
+    assert len(packed) == len(packed.tokens) == 16
+    assert packed.tokens.spelling(11) == "a"
+    assert packed.cursor_kind[11] == int(CursorKind.CXCursor_DeclRefExpr)
+    usrs = [packed.usrs[i] for i in packed.usr]
+    assert usrs[1] == "c:@F@add"
+    assert usrs[4] == usrs[11] == "c:t.c@8@F@add@a"
+    assert usrs[9] == ""  # "{" annotates a statement referencing nothing
+
+    packed = tu.annotate_tokens_packed(extent=tu.cursor.extent, with_usr=False)
+    assert set(packed.usr) == {0} and packed.usrs == [""]
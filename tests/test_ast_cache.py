@@ -0,0 +1,38 @@
+from pylibclang.cindex import AstCache
+
+
+def names(tu):
+    return [c.spelling for c in tu.cursor.get_children()]
+
+
+def test_ast_cache(tmp_path):
+    (tmp_path / "h.h").write_text("int x;\n")
+    main = tmp_path / "main.c"
+    main.write_text('#include "h.h"\nint y;\n')
+    cache_dir = tmp_path / "cache"
+
+    cache = AstCache(cache_dir)
+    assert names(cache.get(main)) == ["x", "y"]
+    assert (cache.misses, cache.stores) == (1, 1)
+
+    # A new instance finds the stored entry on disk.
+    cache = AstCache(cache_dir)
+    assert names(cache.get(main)) == ["x", "y"]
+    assert (cache.hits, cache.misses) == (1, 0)
+
+    (tmp_path / "h.h").write_text("int xx;\n")
+    assert names(cache.get(main)) == ["xx", "y"]
+    assert (cache.stale, cache.misses) == (1, 1)
+    # The outdated AST was replaced, not kept next to the new one.
+    assert len(list(cache_dir.glob("*.ast"))) == 1
+
+
+def test_ast_cache_keys_on_unsaved_files(tmp_path):
+    main = tmp_path / "main.c"
+    main.write_text("int y;\n")
+    cache = AstCache(tmp_path / "cache")
+    unsaved = [(str(main), "int z;\n")]
+    assert names(cache.get(main, unsaved_files=unsaved)) == ["z"]
+    assert names(cache.get(main)) == ["y"]
+    assert names(cache.get(main, unsaved_files=unsaved)) == ["z"]
+    assert (cache.hits, cache.misses) == (1, 2)
@@ -0,0 +1,45 @@
+import asyncio
+
+import pytest
+
+from pylibclang import cindex
+
+
+def test_reparse_async(parse):
+    tu = parse("int x;")
+
+    async def run():
+        await tu.reparse_async([("t.c", "int x; int y;")])
+
+    asyncio.run(run())
+    names = [c.spelling for c in tu.cursor.get_children()]
+    assert names == ["x", "y"]
+
+
+def test_sync_calls_raise_while_async_pending(parse, monkeypatch):
+    tu = parse("int x;")
+    cursor = next(tu.cursor.get_children())
+    pending = []
+
+    class Pool:
+        def reparse(self, tu, unsaved, options, done):
+            pending.append(done)
+
+    monkeypatch.setattr(cindex, "_async_pool", lambda: Pool())
+
+    async def run():
+        task = asyncio.ensure_future(tu.reparse_async())
+        await asyncio.sleep(0)
+        assert len(pending) == 1
+        with pytest.raises(RuntimeError):
+            tu.cursor
+        with pytest.raises(RuntimeError):
+            tu.reparse()
+        with pytest.raises(RuntimeError):
+            cursor.spelling
+        pending[0](0)
+        await task
+
+    asyncio.run(run())
+    assert tu.cursor.kind == cindex.CursorKind.CXCursor_TranslationUnit
+    assert next(tu.cursor.get_children()).spelling == "x"
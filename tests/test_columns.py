@@ -0,0 +1,34 @@
+from pylibclang.cindex import CursorKind
+
+SOURCE = "int add(int a, int b) { return a + b; }"
+
+
+def test_export_columns(parse):
+    tu = parse(SOURCE)
+    cols = tu.cursor.export_columns()
+    kinds = [c.kind for c in tu.cursor.walk_preorder()]
+    assert len(cols) == len(kinds)
+    assert list(cols.kind) == [int(k) for k in kinds]
+    assert cols.parent[0] == -1 and cols.depth[0] == 0
+    assert cols.parent[1] == 0 and cols.depth[1] == 1
+
+    assert cols.files == ["t.c"]
+    assert cols.kind[1] == int(CursorKind.CXCursor_FunctionDecl)
+    assert cols.file[1] == 0
+    assert (cols.line[1], cols.column[1], cols.offset[1]) == (1, 1, 0)
+    assert cols.end_offset[1] == len(SOURCE)
+    assert cols.spellings[cols.spelling[1]] == "add"
+    assert cols.usrs[cols.usr[1]] == "c:@F@add"
+
+
+def test_columns_are_buffers(parse):
+    cols = parse(SOURCE).cursor.export_columns(with_usr=False)
+    view = memoryview(cols.kind)
+    del cols
+    assert view.format == "i" and view.itemsize == 4 and view.readonly
+    assert view[1] == int(CursorKind.CXCursor_FunctionDecl)
+
+
+def test_columns_without_strings(parse):
+    cols = parse(SOURCE).cursor.export_columns(False, False)
+    assert set(cols.usr) == {0} and set(cols.spelling) == {0}
@@ -0,0 +1,40 @@
+import pytest
+
+from pylibclang.cindex import (
+    CompletionService,
+    CursorKind,
+    TranslationUnitLoadError,
+)
+
+SOURCE = """struct P { int x_pos; int y_pos; int xray; };
+void f(struct P p) { p. }
+"""
+
+
+def test_rank(parse):
+    tu = parse(SOURCE)
+    results = tu.codeComplete("t.c", 2, 24, unsaved_files=[("t.c", SOURCE)])
+    assert [r[0] for r in results.rank()] == ["x_pos", "xray", "y_pos"]
+    assert [r[0] for r in results.rank("y")] == ["y_pos", "xray"]
+    assert results.rank("q") == []
+
+    (best,) = results.rank("xray", limit=1)
+    typed_text, display, result_type, _, _, _, index = best
+    assert (typed_text, display, result_type) == ("xray", "xray", "int")
+    assert results.results[index].kind == CursorKind.CXCursor_FieldDecl
+
+
+def test_completion_service():
+    unsaved = [("t.c", SOURCE)]
+    with CompletionService("t.c", unsaved_files=unsaved) as service:
+        items = service.complete("t.c", 2, 24, unsaved, prefix="x", limit=1)
+        assert [i[0] for i in items] == ["x_pos"]
+
+        ids = [service.submit("t.c", 2, 24, unsaved) for _ in range(5)]
+        assert len(service.result(ids[-1])) == 3
+        assert all(service.result(i) is None for i in ids[:-1])
+
+
+def test_completion_service_parse_error(tmp_path):
+    with pytest.raises(TranslationUnitLoadError):
+        CompletionService(tmp_path / "missing.c")
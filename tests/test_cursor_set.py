@@ -0,0 +1,23 @@
+from pylibclang.cindex import CursorSet
+
+
+def test_cursor_hash_and_equality(parse):
+    tu = parse("int x; int y;")
+    first = list(tu.cursor.get_children())
+    second = list(tu.cursor.get_children())
+    assert first[0] == second[0] and hash(first[0]) == hash(second[0])
+    assert first[0] != first[1]
+    assert first[0] != "x"
+    assert len({c: None for c in first + second}) == 2
+
+
+def test_cursor_set(parse):
+    tu = parse("int x; int y;")
+    x, y = tu.cursor.get_children()
+    s = CursorSet()
+    assert s.add(x) and not s.add(x)
+    assert x in s and y not in s
+    assert s.update(list(tu.cursor.get_children())) == 1
+    assert len(s) == 2
+    s.clear()
+    assert len(s) == 0 and x not in s
@@ -0,0 +1,45 @@
+from pylibclang.cindex import Diagnostic, SerializedDiagnosticsError
+
+SOURCE = "int f(void) { int x = 1 return x; }\nint g(int);\nint g(long);\n"
+
+
+def test_diagnostics_packed(parse):
+    tu = parse(SOURCE)
+    packed = tu.diagnostics_packed()
+    strings = packed.strings
+    assert len(packed) == 3
+    assert [strings[i] for i in packed.message] == [
+        "expected ';' at end of declaration",
+        "conflicting types for 'g'",
+        "previous declaration is here",
+    ]
+    assert list(packed.severity) == [
+        Diagnostic.Error, Diagnostic.Error, Diagnostic.Note
+    ]
+    assert list(packed.parent) == [-1, -1, 1]
+    assert packed.files == ["t.c"]
+    assert (packed.line[0], packed.column[0], packed.offset[0]) == (1, 24, 23)
+    assert strings[packed.category_name[0]] == "Parse Issue"
+
+    # The only span is the fix-it inserting the semicolon.
+    assert packed.num_spans == 1
+    assert packed.span_diagnostic[0] == 0 and packed.span_is_fixit[0]
+    assert strings[packed.span_text[0]] == ";"
+    assert packed.span_offset[0] == packed.span_end_offset[0] == 23
+
+    # Agrees with the per-diagnostic API.
+    assert [d.spelling for d in tu.diagnostics] == [
+        strings[packed.message[i]] for i in range(len(packed))
+        if packed.parent[i] == -1
+    ]
+
+
+def test_read_serialized_errors(tmp_path):
+    garbage = tmp_path / "garbage.dia"
+    garbage.write_bytes(b"not a diagnostics file")
+    paths = [tmp_path / "missing.dia", garbage]
+    for workers in (1, 2):
+        results = list(Diagnostic.read_serialized(paths, workers=workers))
+        assert [p for p, _ in results] == paths
+        assert all(isinstance(r, SerializedDiagnosticsError)
+                   for _, r in results)
@@ -0,0 +1,36 @@
+import json
+
+from pylibclang import dump
+
+
+def test_dump_tool(tmp_path):
+    sources = []
+    for i in range(3):
+        path = tmp_path / ("f%d.c" % i)
+        path.write_text("int f%d(void) { return %d; }\n" % (i, i))
+        sources.append(str(path))
+    missing = str(tmp_path / "missing.c")
+    out = tmp_path / "out.ndjson"
+
+    argv = ["-j", "2", "--no-usr", "-o", str(out)] + sources + [missing]
+    status = dump.main(argv + ["--", "-DX=1"])
+    assert status == 1  # missing.c failed, the others are still dumped
+
+    records = [json.loads(line) for line in out.read_text().splitlines()]
+    units = [r for r in records if "tu" in r]
+    assert sorted(r["tu"] for r in units) == sources
+    assert all(r["args"] == ["-DX=1"] for r in units)
+    functions = [r for r in records if r.get("kind") == "FunctionDecl"]
+    assert sorted(r["spelling"] for r in functions) == ["f0", "f1", "f2"]
+    assert all("usr" not in r and r["parent"] == 0 for r in functions)
+
+
+def test_cursor_dump(parse, tmp_path):
+    tu = parse("int x;")
+    with open(tmp_path / "out", "wb") as f:
+        assert tu.cursor.dump(f, max_depth=1) == 2
+    root, var = [json.loads(line) for line in
+                 (tmp_path / "out").read_text().splitlines()]
+    assert root["parent"] is None and root["kind"] == "TranslationUnit"
+    assert (var["kind"], var["spelling"], var["type"]) == ("VarDecl", "x", "int")
+    assert var["usr"] == "c:@x"
@@ -0,0 +1,42 @@
+from pylibclang.cindex import IncrementalIndexer
+
+
+def names(tu):
+    return [c.spelling for c in tu.cursor.get_children()]
+
+
+def test_update_reparses_only_users(tmp_path):
+    header = tmp_path / "h.h"
+    header.write_text("int x;\n")
+    a = tmp_path / "a.c"
+    a.write_text('#include "h.h"\nint a;\n')
+    b = tmp_path / "b.c"
+    b.write_text("int b;\n")
+
+    indexer = IncrementalIndexer([(a, None), (b, None)], workers=2)
+    indexer.build()
+    key_a, key_b = (str(a), ()), (str(b), ())
+    assert sorted(indexer.keys()) == [key_a, key_b]
+    assert indexer.parses == 2 and not indexer.errors
+    assert indexer.affected_by([header]) == [key_a]
+    assert indexer.update() == []
+
+    header.write_text("int xx;\n")
+    assert indexer.changed_files()
+    assert indexer.update() == [key_a]
+    assert indexer.reparses == 1
+    assert names(indexer[key_a]) == ["xx", "a"]
+    assert not indexer.changed_files()
+
+
+def test_update_retries_errors(tmp_path):
+    missing = tmp_path / "missing.c"
+    indexer = IncrementalIndexer([(missing, None)])
+    indexer.build()
+    key = (str(missing), ())
+    assert key in indexer.errors
+
+    missing.write_text("int m;\n")
+    indexer.update(changed=[])
+    assert not indexer.errors
+    assert names(indexer[key]) == ["m"]
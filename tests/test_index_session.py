@@ -0,0 +1,57 @@
+import threading
+
+from pylibclang.cindex import Index, TranslationUnitLoadError
+
+
+def declared(records):
+    return {
+        records.names[records.name[i]]
+        for i in range(len(records))
+        if not records.is_reference[i]
+    }
+
+
+def write_sources(tmp_path, n):
+    (tmp_path / "h.h").write_text("int shared(void);\n")
+    paths = []
+    for i in range(n):
+        path = tmp_path / ("f%d.c" % i)
+        path.write_text('#include "h.h"\nint f%d(void) { return shared(); }\n' % i)
+        paths.append(path)
+    return paths
+
+
+def test_session_emits_headers_once(tmp_path):
+    a, b = write_sources(tmp_path, 2)
+    session = Index.create().index_session()
+    assert declared(session.index_file(a)) == {"shared", "f0"}
+    # The header was indexed with f0.c, only the main file is left.
+    records = session.index_file(b)
+    assert declared(records) == {"f1"}
+    assert [records.names[records.name[i]] for i in range(len(records))
+            if records.is_reference[i]] == ["shared"]
+
+    results = list(session.index_many([(tmp_path / "missing.c", None)]))
+    assert isinstance(results[0][1], TranslationUnitLoadError)
+    stats = session.stats()
+    assert (stats["files"], stats["errors"]) == (3, 1)
+    assert stats["duplicates"] >= 1 and stats["skipped_files"] == 1
+
+
+def test_session_shared_by_threads(tmp_path):
+    paths = write_sources(tmp_path, 8)
+    session = Index.create().index_session()
+    names = []
+
+    def run(part):
+        for path in part:
+            names.extend(declared(session.index_file(path)))
+
+    threads = [threading.Thread(target=run, args=(paths[i::2],))
+               for i in range(2)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert sorted(names) == sorted(["shared"] + ["f%d" % i for i in range(8)])
+    assert session.stats()["files"] == 8
@@ -0,0 +1,47 @@
+import pytest
+
+from pylibclang import _C
+from pylibclang.cindex import Index, TranslationUnitLoadError
+
+SOURCE = "int g; int add(int a) { return a + g; }\n"
+
+
+def rows(records):
+    usrs, names = records.usrs, records.names
+    return [
+        (
+            bool(records.is_reference[i]),
+            names[records.name[i]],
+            usrs[records.usr[i]],
+            usrs[records.container[i]],
+            records.flags[i],
+        )
+        for i in range(len(records))
+    ]
+
+
+def test_index_file(tmp_path):
+    path = tmp_path / "t.c"
+    path.write_text(SOURCE)
+    records = Index.create().index_file(path)
+    assert records.files == [str(path)]
+    assert set(records.file) == {0}
+    decls = {r[1]: r for r in rows(records) if not r[0]}
+    assert set(decls) == {"g", "add"}  # no function local symbols
+    assert decls["add"][2] == "c:@F@add"
+    assert decls["add"][4] & _C.INDEX_RECORD_DEFINITION
+    refs = [r for r in rows(records) if r[0]]
+    assert [(r[1], r[3]) for r in refs] == [("g", "c:@F@add")]
+
+    records = Index.create().index_file(path, with_references=False)
+    assert not any(records.is_reference)
+
+
+def test_index_symbols_of_translation_unit(parse):
+    records = parse(SOURCE).index_symbols()
+    assert {r[1] for r in rows(records) if not r[0]} == {"g", "add"}
+
+
+def test_index_file_error(tmp_path):
+    with pytest.raises(TranslationUnitLoadError):
+        Index.create().index_file(tmp_path / "missing.c")
@@ -0,0 +1,50 @@
+import array
+
+import pytest
+
+from pylibclang import _C
+from pylibclang.cindex import CursorKind, TypeKind
+
+
+def test_cursor_kind_spelling():
+    assert CursorKind.CXCursor_FunctionDecl.spelling == "FunctionDecl"
+    assert CursorKind.CXCursor_TranslationUnit.spelling == "TranslationUnit"
+    assert _C.cursor_kind_spelling(int(CursorKind.CXCursor_StructDecl)) == (
+        "StructDecl"
+    )
+
+
+def test_type_kind_spelling():
+    assert TypeKind.CXType_Int.spelling == "Int"
+    assert TypeKind.CXType_Pointer.spelling == "Pointer"
+
+
+def test_unknown_kind_spells_empty():
+    assert _C.cursor_kind_spelling(60) == ""
+    assert _C.cursor_kind_spelling(-1) == ""
+    assert _C.type_kind_spelling(10000) == ""
+
+
+def test_spellings_of_buffer():
+    kinds = array.array("i", [int(CursorKind.CXCursor_FunctionDecl), 60])
+    assert _C.cursor_kind_spellings(kinds) == ["FunctionDecl", ""]
+
+
+def test_kind_predicates():
+    assert CursorKind.CXCursor_FunctionDecl.is_declaration()
+    assert not CursorKind.CXCursor_FunctionDecl.is_expression()
+    assert CursorKind.CXCursor_DeclRefExpr.is_expression()
+    assert _C.type_kind_is(int(TypeKind.CXType_UInt), _C.TYPE_KIND_UNSIGNED_INTEGER)
+
+
+def test_flags_of_buffer():
+    kinds = array.array("q", [int(CursorKind.CXCursor_FunctionDecl),
+                              int(CursorKind.CXCursor_ReturnStmt), 5000])
+    assert list(_C.cursor_kind_flags(kinds)) == [
+        _C.CURSOR_KIND_DECLARATION, _C.CURSOR_KIND_STATEMENT, 0
+    ]
+    assert _C.classify_cursor_kinds(kinds, _C.CURSOR_KIND_STATEMENT) == (
+        bytearray([0, 1, 0])
+    )
+    with pytest.raises(ValueError):
+        _C.cursor_kind_flags(array.array("d", [1.0]))
@@ -0,0 +1,20 @@
+from pylibclang.cindex import Index, TranslationUnitLoadError
+
+
+def test_parse_many(tmp_path):
+    commands = []
+    for i in range(6):
+        path = tmp_path / ("t%d.c" % i)
+        path.write_text("int v%d;" % i)
+        commands.append((path, []))
+    results = list(Index.create().parse_many(commands, workers=2))
+    assert len(results) == 6
+    for (path, _), tu in results:
+        names = [c.spelling for c in tu.cursor.get_children()]
+        assert names == ["v" + path.stem[1:]]
+
+
+def test_parse_many_reports_errors(tmp_path):
+    results = list(Index.create().parse_many([(tmp_path / "missing.c", [])]))
+    assert len(results) == 1
+    assert isinstance(results[0][1], TranslationUnitLoadError)
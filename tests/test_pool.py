@@ -0,0 +1,38 @@
+from pylibclang.cindex import TranslationUnitPool
+
+
+def names(tu):
+    return [c.spelling for c in tu.cursor.get_children()]
+
+
+def test_pool_reuses_and_reparses():
+    pool = TranslationUnitPool()
+    tu = pool.get("a.c", unsaved_files=[("a.c", "int x;")])
+    assert names(tu) == ["x"]
+    assert pool.get("a.c") is tu
+    assert ("a.c", None) in pool and len(pool) == 1
+
+    tu = pool.get("a.c", unsaved_files=[("a.c", "int y;")])
+    assert names(tu) == ["y"]
+    # The last unsaved files are kept for reparses without new ones.
+    assert names(pool.update("a.c")) == ["y"]
+    stats = pool.stats()
+    assert (stats["parses"], stats["reparses"], stats["hits"]) == (1, 2, 1)
+
+
+def test_pool_max_entries():
+    pool = TranslationUnitPool(max_entries=2)
+    for name in ("a.c", "b.c", "c.c"):
+        pool.get(name, unsaved_files=[(name, "int x;")])
+    assert len(pool) == 2 and ("a.c", None) not in pool
+    assert pool.stats()["evictions"] == 1
+    assert pool.evict("b.c") and not pool.evict("b.c")
+
+
+def test_pool_memory_budget_keeps_latest():
+    pool = TranslationUnitPool(memory_budget=0)
+    for name in ("a.c", "b.c"):
+        pool.get(name, unsaved_files=[(name, "int x;")])
+    # Nothing fits, everything but the entry just handed out goes.
+    assert len(pool) == 1 and ("b.c", None) in pool
+    assert pool.stats()["evictions"] == 1
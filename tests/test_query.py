@@ -0,0 +1,34 @@
+import pytest
+
+from pylibclang.cindex import CursorKind
+
+SOURCE = """
+struct point { int x, y; };
+int add(int a, int b) { return a + b; }
+int sub(int a, int b) { return a - b; }
+"""
+
+
+def test_query_kinds(parse):
+    tu = parse(SOURCE)
+    found = tu.cursor.query(kinds=[CursorKind.CXCursor_FunctionDecl])
+    assert [c.spelling for c in found] == ["add", "sub"]
+
+
+def test_query_spelling(parse):
+    tu = parse(SOURCE)
+    found = tu.cursor.query(
+        kinds=[CursorKind.CXCursor_ParmDecl], spelling="^a$"
+    )
+    assert [c.semantic_parent.spelling for c in found] == ["add", "sub"]
+
+
+def test_query_max_depth(parse):
+    tu = parse(SOURCE)
+    assert len(tu.cursor.query(max_depth=1)) == 3
+
+
+def test_query_invalid_regex(parse):
+    tu = parse(SOURCE)
+    with pytest.raises(ValueError, match="spelling_regex"):
+        tu.cursor.query(spelling="(")
@@ -0,0 +1,22 @@
+import gc
+
+import pytest
+
+
+def test_cursor_has_no_dict(parse):
+    tu = parse("int x;")
+    cursor = next(tu.cursor.get_children())
+    assert not hasattr(cursor, "__dict__")
+    assert not gc.is_tracked(cursor)
+    with pytest.raises(AttributeError):
+        cursor.cached = 1
+    assert cursor.translation_unit is tu
+    assert cursor.type.translation_unit is tu
+    assert not hasattr(cursor.type, "__dict__")
+
+
+def test_cursor_keeps_translation_unit_alive(parse):
+    cursor = next(parse("int x;").cursor.get_children())
+    gc.collect()
+    assert cursor.spelling == "x"
+    assert cursor.type.spelling == "int"
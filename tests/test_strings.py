@@ -0,0 +1,27 @@
+from pylibclang import _C
+
+
+def test_string_results_are_str(parse):
+    tu = parse("int foo(int bar);")
+    decl = next(tu.cursor.get_children())
+    assert decl.spelling == "foo"
+    assert isinstance(decl.spelling, str)
+
+
+def test_interning_shares_strings(parse):
+    tu = parse("int foo; int foo;")
+    tu.enable_string_interning()
+    first, second = tu.cursor.get_children()
+    assert first.spelling is second.spelling
+    assert first.location.file.name is second.location.file.name
+    assert _C.string_interning_size(tu) > 0
+
+
+def test_interning_capacity(parse):
+    tu = parse("int a; int b; int c;")
+    tu.enable_string_interning(capacity=1)
+    names = [c.spelling for c in tu.cursor.get_children()]
+    assert names == ["a", "b", "c"]
+    assert _C.string_interning_size(tu) == 1
+    tu.enable_string_interning(False)
+    assert _C.string_interning_size(tu) == 0
@@ -0,0 +1,29 @@
+import concurrent.futures
+
+from pylibclang import cindex
+
+COMPLETE = """
+struct point { int x, y; };
+int f(struct point p) { return p.
+"""
+
+
+def test_parse_from_threads():
+    index = cindex.Index.create()
+
+    def parse(i):
+        name = "t%d.c" % i
+        tu = index.parse(name, unsaved_files=[(name, "int v%d;" % i)])
+        return [c.spelling for c in tu.cursor.get_children()]
+
+    with concurrent.futures.ThreadPoolExecutor(4) as pool:
+        results = list(pool.map(parse, range(16)))
+    assert results == [["v%d" % i] for i in range(16)]
+
+
+def test_code_complete(parse):
+    tu = parse(COMPLETE)
+    results = tu.codeComplete("t.c", 3, 34, unsaved_files=[("t.c", COMPLETE)])
+    assert results is not None
+    names = [r[0] for r in results.rank()]
+    assert "x" in names and "y" in names
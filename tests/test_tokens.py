@@ -0,0 +1,24 @@
+SOURCE = "int add(int a, int b) { return a + b; }"
+SPELLINGS = "int add ( int a , int b ) { return a + b ; }".split()
+
+
+def test_tokens_packed(parse):
+    tu = parse(SOURCE)
+    packed = tu.get_tokens_packed(extent=tu.cursor.extent)
+    tokens = list(tu.get_tokens(extent=tu.cursor.extent))
+    assert len(packed) == len(tokens) == len(SPELLINGS)
+    assert packed.spellings == SPELLINGS
+    assert packed.spelling(1) == "add"
+    assert packed.text == "".join(SPELLINGS).encode()
+    assert list(packed.kind) == [int(t.kind) for t in tokens]
+    assert list(packed.offset) == [t.extent.start.offset for t in tokens]
+    assert list(packed.end_offset) == [t.extent.end.offset for t in tokens]
+    assert list(packed.line) == [1] * len(tokens)
+    assert list(packed.column) == [t.location.column for t in tokens]
+
+
+def test_cursor_tokens_packed(parse):
+    tu = parse(SOURCE)
+    (func,) = tu.cursor.get_children()
+    body = list(func.get_children())[-1]
+    assert body.get_tokens_packed().spellings == SPELLINGS[9:]
@@ -0,0 +1,56 @@
+import mmap
+
+import pytest
+
+from pylibclang.cindex import Index, UnsavedFileSet
+
+
+def names(tu):
+    return [c.spelling for c in tu.cursor.get_children()]
+
+
+def test_unsaved_file_set_contents():
+    files = UnsavedFileSet()
+    files.set("a.h", "int a;")
+    files.set("b.h", b"int b;")
+    files.set("c.h", memoryview(b"xxint c;")[2:])
+    files.update([("d.h", bytearray(b"int d;"))])
+    assert len(files) == 4 and "a.h" in files and "e.h" not in files
+    assert sorted(files.names()) == ["a.h", "b.h", "c.h", "d.h"]
+    assert files.get("a.h") == b"int a;"
+    assert bytes(files.get("c.h")) == b"int c;"
+    with pytest.raises(KeyError):
+        files.get("e.h")
+    assert files.remove("d.h") and not files.remove("d.h")
+    files.clear()
+    assert len(files) == 0
+
+
+def test_parse_and_reparse_with_set():
+    files = UnsavedFileSet()
+    files.set("t.c", '#include "h.h"\nint main_var;')
+    files.set("h.h", "int x;")
+    tu = Index.create().parse("t.c", unsaved_files=files)
+    assert names(tu) == ["x", "main_var"]
+
+    files.set("h.h", "int y;")
+    tu.reparse(files)
+    assert names(tu) == ["y", "main_var"]
+
+
+def test_pinned_buffers(tmp_path):
+    data = bytearray(b"int z;")
+    files = UnsavedFileSet()
+    files.set("t.c", data)
+    # The set reads the buffer in place, so it can not be resized meanwhile.
+    with pytest.raises(BufferError):
+        data.extend(b" ")
+    files.remove("t.c")
+    data.extend(b" ")
+
+    path = tmp_path / "t.c"
+    path.write_bytes(b"int m;")
+    with open(path, "rb") as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as m:
+        files.set("t.c", m)
+        assert names(Index.create().parse("t.c", unsaved_files=files)) == ["m"]
+        files.clear()
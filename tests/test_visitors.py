@@ -0,0 +1,53 @@
+import pytest
+
+from pylibclang import _C
+
+CONTINUE = _C.CXChildVisitResult.CXChildVisit_Continue
+SOURCE = """
+#include "point.h"
+struct line { struct point a, b; };
+"""
+HEADER = ("point.h", "struct point { int x, y; };")
+
+
+def test_nested_visitors(parse):
+    tu = parse(SOURCE, headers=[HEADER])
+    seen = []
+
+    def inner(child, parent, data):
+        seen.append(child.spelling)
+        return CONTINUE
+
+    def outer(child, parent, data):
+        _C.clang_visitChildren(child, inner, _C.voidp(0))
+        return CONTINUE
+
+    _C.clang_visitChildren(tu.cursor, outer, _C.voidp(0))
+    assert seen == ["x", "y", "a", "b"]
+
+
+def test_visitor_exception_stops_the_walk(parse):
+    tu = parse(SOURCE, headers=[HEADER])
+    calls = []
+
+    def visitor(child, parent, data):
+        calls.append(child)
+        raise KeyError("stop")
+
+    with pytest.raises(KeyError):
+        _C.clang_visitChildren(tu.cursor, visitor, _C.voidp(0))
+    assert len(calls) == 1
+
+
+def test_get_includes(parse):
+    tu = parse(SOURCE, headers=[HEADER])
+    includes = list(tu.get_includes())
+    assert [i.include.name for i in includes] == ["point.h"]
+    assert includes[0].depth == 1
+    assert includes[0].source.name == "t.c"
+
+
+def test_get_fields(parse):
+    tu = parse(SOURCE, headers=[HEADER])
+    line = tu.cursor.query(spelling="^line$")[0]
+    assert [f.spelling for f in line.type.get_fields()] == ["a", "b"]
@@ -0,0 +1,35 @@
+from pylibclang import _C
+from pylibclang.cindex import CursorKind
+
+SOURCE = "int add(int a, int b) { return a + b; }"
+
+
+def test_walk_preorder(parse):
+    tu = parse(SOURCE)
+    kinds = [c.kind for c in tu.cursor.walk_preorder()]
+    assert kinds[:7] == [
+        CursorKind.CXCursor_TranslationUnit,
+        CursorKind.CXCursor_FunctionDecl,
+        CursorKind.CXCursor_ParmDecl,
+        CursorKind.CXCursor_ParmDecl,
+        CursorKind.CXCursor_CompoundStmt,
+        CursorKind.CXCursor_ReturnStmt,
+        CursorKind.CXCursor_BinaryOperator,
+    ]
+    assert kinds.count(CursorKind.CXCursor_DeclRefExpr) == 2
+
+
+def test_get_children(parse):
+    tu = parse(SOURCE)
+    (func,) = tu.cursor.get_children()
+    assert [c.spelling for c in func.get_children()][:2] == ["a", "b"]
+
+
+def test_walk_subtree_parents_and_depths(parse):
+    tu = parse(SOURCE)
+    walk = _C.walk_subtree(tu.cursor)
+    assert walk.parent(0) == -1 and walk.depth(0) == 0
+    for i in range(1, len(walk)):
+        assert walk.depth(i) == walk.depth(walk.parent(i)) + 1
+    assert len(_C.walk_subtree(tu.cursor, 0)) == 1
+    assert len(_C.walk_subtree(tu.cursor, 1)) == 2